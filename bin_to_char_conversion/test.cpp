@@ -4,6 +4,7 @@
 #include <random>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 
 typedef std::chrono::high_resolution_clock clock_type;
 typedef std::chrono::microseconds duration_type;
@@ -0,0 +1,409 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <immintrin.h>
+
+#include "simd_add.hpp"
+
+constexpr uint64_t LINE_SIZE = 64;
+
+/* The data structures take the cache as a template parameter (a policy) and call its map
+   method on every value they read. no_tracer ignores them: as its map is empty and inlined,
+   the calls compile away and the timings are those of the data structures alone. */
+
+struct no_tracer {
+    template <typename T>
+    void map(T const&) const {}
+};
+
+/* A set-associative LRU cache simulator, that also counts the distinct cache lines
+   mapped to each set (to discover cache aliasing).
+
+   - Each set is a fixed-size array of ways tags, kept in recency order (the most recently
+     used first): a hit moves the tag to the front and a miss shifts the others back,
+     evicting the last one. The tags of all sets are in one flat array.
+   - The sets are split into num_threads shards of contiguous sets. Each access is buffered
+     in the batch of the shard of its set, so that the accesses to each set stay in order.
+     When a batch is full, all of them are simulated: shard 0 by the calling thread and each
+     other shard by a worker thread, started with the cache and waiting for the batches.
+   - The tags of a set are searched and shifted with vector instructions (for 4, 8 and 16
+     ways), by the kernels of the ISA level selected in simd_add.hpp.
+   - A line is a miss the first time it is accessed, so the distinct lines are found by
+     inserting only the missed ones into a set of bitmaps per shard. */
+
+struct cache {
+    cache(uint64_t s, uint64_t w, uint64_t num_threads = 1)
+        : size(s)
+        , ways(w)
+        , sets((size / LINE_SIZE) / ways)
+        , m_threads(std::max<uint64_t>(1, std::min(num_threads, sets)))
+        , m_tags(sets * ways, invalid_line)
+        , m_shards(m_threads)
+        , m_shard_of(sets)
+        , m_stop(false)
+        , m_generation(0)
+        , m_pending(0) {
+        if (size % (LINE_SIZE * ways) != 0 or sets == 0) {
+            throw std::runtime_error("cache size must be divisible by the line size times ways");
+        }
+        m_set_mask = (sets & (sets - 1)) == 0 ? sets - 1 : 0;
+        for (uint64_t t = 0; t != m_threads; ++t) {
+            m_shards[t].first = sets * t / m_threads;
+            m_shards[t].last = sets * (t + 1) / m_threads;
+            m_shards[t].batch.reserve(batch_size);
+            for (uint64_t set = m_shards[t].first; set != m_shards[t].last; ++set) {
+                m_shard_of[set] = t;
+            }
+        }
+        for (uint64_t t = 1; t < m_threads; ++t) m_workers.emplace_back([this, t] { work(t); });
+    }
+
+    // the workers point to the cache
+    cache(cache const&) = delete;
+    cache& operator=(cache const&) = delete;
+
+    ~cache() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_start.notify_all();
+        for (auto& t : m_workers) t.join();
+    }
+
+    template <typename T>
+    void map(T const& x) {
+        access(reinterpret_cast<uint64_t>(&x) / LINE_SIZE);
+    }
+
+    void access(uint64_t line) {
+        std::vector<uint64_t>& batch = m_shards[m_threads == 1 ? 0 : m_shard_of[set_of(line)]].batch;
+        batch.push_back(line);
+        if (batch.size() == batch_size) flush();
+    }
+
+    // simulate the buffered accesses
+    void flush() {
+        if (m_threads != 1) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_generation += 1;
+                m_pending = m_threads - 1;
+            }
+            m_start.notify_all();
+        }
+        simulate(m_shards[0]);
+        if (m_threads != 1) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [&] { return m_pending == 0; });
+        }
+    }
+
+    void print_usage() {
+        std::cout << "cache specification:\n";
+        std::cout << "  size " << size << "\n";
+        std::cout << "  ways " << ways << "\n";
+        std::cout << "  sets " << sets << "\n";
+        std::cout << "cache usage:\n";
+        for (uint64_t count : distinct_lines_per_set()) std::cout << count << " ";
+        std::cout << std::endl;
+    }
+
+    void clear() {
+        std::fill(m_tags.begin(), m_tags.end(), invalid_line);
+        for (auto& s : m_shards) {
+            s.batch.clear();
+            s.distinct = line_set();
+            s.accesses = 0;
+            s.misses = 0;
+        }
+    }
+
+    // number of simulated accesses
+    uint64_t accesses() {
+        flush();
+        uint64_t sum = 0;
+        for (auto const& s : m_shards) sum += s.accesses;
+        return sum;
+    }
+
+    uint64_t misses() {
+        flush();
+        uint64_t sum = 0;
+        for (auto const& s : m_shards) sum += s.misses;
+        return sum;
+    }
+
+    uint64_t distinct_lines() {
+        uint64_t sum = 0;
+        for (uint64_t count : distinct_lines_per_set()) sum += count;
+        return sum;
+    }
+
+    // distinct_lines_per_set()[i] := the number of distinct lines mapped to set i
+    std::vector<uint64_t> distinct_lines_per_set() {
+        flush();
+        std::vector<uint64_t> counts(sets, 0);
+        for (auto const& s : m_shards) {
+            s.distinct.for_each([&](uint64_t line) { counts[set_of(line)] += 1; });
+        }
+        return counts;
+    }
+
+private:
+    static constexpr uint64_t invalid_line = uint64_t(-1);
+    static constexpr uint64_t batch_size = uint64_t(1) << 16;
+
+    /* A set of lines, as bitmaps of chunks of 2^chunk_bits consecutive lines: the lines of
+       a data structure are clustered, so the bitmaps are small and dense. The chunks are
+       found with an open-addressing hash table (with linear probing) whose slots hold the
+       chunk and its bitmap, so that a line of a known chunk costs a single probe. */
+    struct line_set {
+        static constexpr uint64_t chunk_bits = 12;
+        static constexpr uint64_t words_per_chunk = (uint64_t(1) << chunk_bits) / 64;
+
+        line_set() : m_slots(64, {invalid_line, 0}), m_chunks(0) {}
+
+        inline void insert(uint64_t line) {
+            insert_if(line, true);
+        }
+
+        /* Insert the line only if add is true, without a branch: a kernel that can tell a
+           hit from a miss without one does not mispredict on the hits. */
+        inline void insert_if(uint64_t line, bool add) {
+            uint64_t chunk = line >> chunk_bits;
+            slot const& s = m_slots[hash(chunk) & (m_slots.size() - 1)];
+            uint64_t index = s.chunk == chunk ? s.index : find_or_add(chunk);
+            uint64_t bit = line & ((uint64_t(1) << chunk_bits) - 1);
+            m_bits[index * words_per_chunk + bit / 64] |= uint64_t(add) << (bit % 64);
+        }
+
+        template <typename F>
+        void for_each(F f) const {
+            for (auto const& s : m_slots) {
+                if (s.chunk == invalid_line) continue;
+                uint64_t const* words = m_bits.data() + s.index * words_per_chunk;
+                for (uint64_t w = 0; w != words_per_chunk; ++w) {
+                    for (uint64_t x = words[w]; x; x &= x - 1) {
+                        f((s.chunk << chunk_bits) + w * 64 + __builtin_ctzll(x));
+                    }
+                }
+            }
+        }
+
+    private:
+        struct slot {
+            uint64_t chunk;
+            uint64_t index;  // of the bitmap of the chunk
+        };
+
+        std::vector<slot> m_slots;     // hash table of the chunks
+        uint64_t m_chunks;             // number of chunks
+        std::vector<uint64_t> m_bits;  // the bitmaps, words_per_chunk words each
+
+        // the identity: consecutive chunks go to consecutive slots, without collisions
+        static uint64_t hash(uint64_t x) {
+            return x;
+        }
+
+        // out of line, to keep insert small: a new chunk or a collision is rare
+        __attribute__((noinline)) uint64_t find_or_add(uint64_t chunk) {
+            uint64_t mask = m_slots.size() - 1;
+            uint64_t i = hash(chunk) & mask;
+            while (m_slots[i].chunk != invalid_line) {
+                if (m_slots[i].chunk == chunk) return m_slots[i].index;
+                i = (i + 1) & mask;
+            }
+            if (2 * (m_chunks + 1) > m_slots.size()) {
+                grow();
+                return find_or_add(chunk);
+            }
+            m_slots[i] = {chunk, m_chunks};
+            m_bits.resize(m_bits.size() + words_per_chunk, 0);
+            return m_chunks++;
+        }
+
+        void grow() {
+            std::vector<slot> slots(2 * m_slots.size(), {invalid_line, 0});
+            uint64_t mask = slots.size() - 1;
+            for (auto const& s : m_slots) {
+                if (s.chunk == invalid_line) continue;
+                uint64_t i = hash(s.chunk) & mask;
+                while (slots[i].chunk != invalid_line) i = (i + 1) & mask;
+                slots[i] = s;
+            }
+            m_slots.swap(slots);
+        }
+    };
+
+    // a contiguous range of sets, with the accesses to them and their statistics
+    struct shard {
+        uint64_t first, last;         // the sets are [first, last)
+        std::vector<uint64_t> batch;  // the buffered accesses, in order
+        line_set distinct;            // the distinct lines
+        uint64_t accesses = 0;
+        uint64_t misses = 0;
+    };
+
+    uint64_t size;  // in bytes
+    uint64_t ways;
+    uint64_t sets;
+    uint64_t m_set_mask;  // sets - 1 if sets is a power of 2, otherwise 0
+    uint64_t m_threads;
+    std::vector<uint64_t> m_tags;  // m_tags[set * ways + i] := the i-th most recent line
+    std::vector<shard> m_shards;
+    std::vector<uint32_t> m_shard_of;  // m_shard_of[set] := the shard of the set
+
+    // the workers (for the shards but the first), waiting for each batch
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_start, m_done;
+    bool m_stop;
+    uint64_t m_generation;  // number of batches started
+    uint64_t m_pending;     // number of workers still simulating the current batch
+
+    uint64_t set_of(uint64_t line) const {
+        return m_set_mask ? line & m_set_mask : line % sets;
+    }
+
+    void work(uint64_t t) {
+        uint64_t generation = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_start.wait(lock, [&] { return m_stop or m_generation != generation; });
+                if (m_stop) return;
+                generation = m_generation;
+            }
+            simulate(m_shards[t]);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_pending == 0) m_done.notify_one();
+        }
+    }
+
+    // simulate the batch of the shard, with the kernel of the ways and the ISA level
+    void simulate(shard& s) {
+        if (s.batch.empty()) return;
+        simd::isa level = simd::current();
+        if (level == simd::isa::avx512 and ways == 8) {
+            simulate_avx512<8>(s);
+        } else if (level == simd::isa::avx512 and ways == 16) {
+            simulate_avx512<16>(s);
+        } else if (level != simd::isa::scalar and ways == 4) {
+            simulate_avx2<4>(s);
+        } else if (level != simd::isa::scalar and ways == 8) {
+            simulate_avx2<8>(s);
+        } else if (level != simd::isa::scalar and ways == 16) {
+            simulate_avx2<16>(s);
+        } else if (ways == 4) {
+            simulate_scalar<4>(s);
+        } else if (ways == 8) {
+            simulate_scalar<8>(s);
+        } else if (ways == 16) {
+            simulate_scalar<16>(s);
+        } else {
+            simulate_scalar<0>(s);
+        }
+        s.accesses += s.batch.size();
+        s.batch.clear();
+    }
+
+    /* The kernels: they differ in how an access finds the position of its line in the
+       recency order of the set and moves it to the front. The common associativities
+       are compile-time constants (Ways = 0 for any ways). */
+
+    template <uint64_t Ways>
+    void simulate_scalar(shard& s) {
+        // local copies, that the compiler cannot keep in registers across the stores to tags
+        uint64_t const num_ways = Ways ? Ways : ways;
+        uint64_t const mask = m_set_mask, num_sets = sets;
+        uint64_t* const all_tags = m_tags.data();
+        uint64_t misses = 0;
+        for (uint64_t line : s.batch) {
+            uint64_t* tags = all_tags + (mask ? line & mask : line % num_sets) * num_ways;
+            if (tags[0] == line) continue;  // fast path: same line as the last access
+            uint64_t i = 1;
+            while (i != num_ways and tags[i] != line) ++i;
+            if (i == num_ways) {  // miss: evict the least recently used line
+                i = num_ways - 1;
+                misses += 1;
+                s.distinct.insert(line);
+            }
+            for (; i != 0; --i) tags[i] = tags[i - 1];
+            tags[0] = line;
+        }
+        s.misses += misses;
+    }
+
+    // the tags are compared 4 at a time, then shifted as in the scalar kernel
+    template <uint64_t Ways>
+    __attribute__((target("avx2"))) void simulate_avx2(shard& s) {
+        static_assert(Ways % 4 == 0);
+        uint64_t const mask = m_set_mask, num_sets = sets;
+        uint64_t* const all_tags = m_tags.data();
+        uint64_t misses = 0;
+        for (uint64_t line : s.batch) {
+            uint64_t* tags = all_tags + (mask ? line & mask : line % num_sets) * Ways;
+            if (tags[0] == line) continue;
+            __m256i l = _mm256_set1_epi64x(line);
+            uint64_t hit = 0;  // bit i is set if tags[i] == line
+            for (uint64_t w = 0; w != Ways; w += 4) {
+                __m256i t = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(tags + w));
+                uint64_t m = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(t, l)));
+                hit |= m << w;
+            }
+            uint64_t i = Ways - 1;
+            if (hit) {
+                i = __builtin_ctzll(hit);
+            } else {
+                misses += 1;
+                s.distinct.insert(line);
+            }
+            for (; i != 0; --i) tags[i] = tags[i - 1];
+            tags[0] = line;
+        }
+        s.misses += misses;
+    }
+
+    /* The 8 (or 16) tags of a set are one (or two) vectors: the line is shifted in as the
+       first lane, and only the lanes up to its previous position (all of them on a miss)
+       take the shifted tags. */
+    template <uint64_t Ways>
+    __attribute__((target("avx512f"))) void simulate_avx512(shard& s) {
+        static_assert(Ways == 8 or Ways == 16);
+        uint64_t const mask = m_set_mask, num_sets = sets;
+        uint64_t* const all_tags = m_tags.data();
+        uint64_t misses = 0;
+        for (uint64_t line : s.batch) {
+            uint64_t* tags = all_tags + (mask ? line & mask : line % num_sets) * Ways;
+            // the fast path only pays off when it saves the load and compare of a second vector
+            if constexpr (Ways == 16) {
+                if (tags[0] == line) continue;
+            }
+            __m512i l = _mm512_set1_epi64(line);
+            __m512i t0 = _mm512_loadu_si512(tags), t1 = t0;  // t1: the last 8 of 16 ways
+            // the masks are widened to 16 bits with mask instructions: GCC 12 can spill an
+            // 8-bit mask with a byte store and reload it as a wider integer
+            __mmask16 m = _mm512_cmpeq_epi64_mask(t0, l);
+            if constexpr (Ways == 16) {
+                t1 = _mm512_loadu_si512(tags + 8);
+                m = _mm512_kunpackb(_mm512_cmpeq_epi64_mask(t1, l), m);
+            }
+            uint32_t hit = _cvtmask16_u32(m);  // bit i is set if tags[i] == line
+            uint32_t keep = hit ? (hit << 1) - 1 : (1 << Ways) - 1;
+            _mm512_storeu_si512(tags, _mm512_mask_alignr_epi64(t0, keep, t0, l, 7));
+            if constexpr (Ways == 16) {
+                _mm512_storeu_si512(tags + 8, _mm512_mask_alignr_epi64(t1, keep >> 8, t1, t0, 7));
+            }
+            misses += !hit;
+            s.distinct.insert_if(line, !hit);
+        }
+        s.misses += misses;
+    }
+};
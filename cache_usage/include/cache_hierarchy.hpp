@@ -0,0 +1,324 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <string>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+/* A multi-level cache hierarchy simulator.
+
+   Each level is a set-associative cache with its own size, number of ways, line size
+   and replacement policy:
+   - lru: the least recently used line of the set is evicted;
+   - plru: tree pseudo-LRU, with ways - 1 bits per set (ways must be a power of 2);
+   - rrip: static RRIP [Jaleel et al., ISCA 2010] with 2-bit re-reference predictions,
+     inserting lines with a "long" prediction so that scans do not flush the set.
+
+   The hierarchy is either inclusive (a line filled into a level is also filled into
+   all the levels above it, and a line evicted from a level is invalidated in the levels
+   above it) or exclusive (a line is in at most one level: it is filled into the first
+   level only, and each level is filled with the lines evicted from the level above it).
+
+   The misses of each level are classified as in [Hill and Smith, IEEE TC 1989]:
+   compulsory if the line was never accessed at that level, capacity if it also misses
+   in a fully-associative LRU cache of the same size fed with the same accesses, and
+   conflict otherwise. */
+
+enum class replacement { lru, plru, rrip };
+
+enum class inclusion { inclusive, exclusive };
+
+struct cache_config {
+    uint64_t size;  // in bytes
+    uint64_t ways;
+    uint64_t line_size;
+    replacement policy;
+};
+
+struct cache_level {
+    static constexpr uint64_t invalid_line = uint64_t(-1);
+    static constexpr uint8_t max_rrpv = 3;
+
+    struct statistics {
+        uint64_t hits = 0;
+        uint64_t compulsory = 0;
+        uint64_t capacity = 0;
+        uint64_t conflict = 0;
+
+        uint64_t misses() const {
+            return compulsory + capacity + conflict;
+        }
+
+        uint64_t accesses() const {
+            return hits + misses();
+        }
+    };
+
+    cache_level(cache_config const& config)
+        : m_config(config)
+        , m_sets(config.size / config.line_size / config.ways)
+        , m_lines(config.size / config.line_size)
+        , m_clock(0)
+        , m_tags(m_sets * config.ways, invalid_line)
+        , m_state(m_sets * config.ways, 0)
+        , m_plru_bits(config.policy == replacement::plru ? m_sets * config.ways : 0, 0) {
+        if (config.size % (config.line_size * config.ways) != 0 or m_sets == 0) {
+            throw std::runtime_error("cache size must be a multiple of line size times ways");
+        }
+        if (config.policy == replacement::plru and (config.ways & (config.ways - 1)) != 0) {
+            throw std::runtime_error("tree pseudo-LRU requires a power-of-2 number of ways");
+        }
+    }
+
+    cache_config const& config() const {
+        return m_config;
+    }
+
+    statistics const& stats() const {
+        return m_stats;
+    }
+
+    /* Access the line, classifying the access: return true on a hit
+       (the line is then the most recently used of its set). */
+    bool access(uint64_t line) {
+        bool hit = touch(line);
+        bool seen = !m_seen.insert(line).second;
+        bool shadow_hit = shadow_access(line);
+        if (hit) {
+            m_stats.hits += 1;
+        } else if (!seen) {
+            m_stats.compulsory += 1;
+        } else if (!shadow_hit) {
+            m_stats.capacity += 1;
+        } else {
+            m_stats.conflict += 1;
+        }
+        return hit;
+    }
+
+    bool contains(uint64_t line) const {
+        return find(line) != invalid_line;
+    }
+
+    // fill the line (that must not be present) and return the evicted line, if any
+    uint64_t fill(uint64_t line) {
+        uint64_t set = line % m_sets;
+        uint64_t way = victim(set);
+        uint64_t slot = set * m_config.ways + way;
+        uint64_t evicted = m_tags[slot];
+        m_tags[slot] = line;
+        switch (m_config.policy) {
+            case replacement::lru:
+                m_state[slot] = ++m_clock;
+                break;
+            case replacement::plru:
+                plru_touch(set, way);
+                break;
+            case replacement::rrip:
+                m_state[slot] = max_rrpv - 1;
+                break;
+        }
+        return evicted;
+    }
+
+    // remove the line, if present
+    bool invalidate(uint64_t line) {
+        uint64_t slot = find(line);
+        if (slot == invalid_line) return false;
+        m_tags[slot] = invalid_line;
+        m_state[slot] = 0;
+        return true;
+    }
+
+    void clear() {
+        std::fill(m_tags.begin(), m_tags.end(), invalid_line);
+        std::fill(m_state.begin(), m_state.end(), 0);
+        std::fill(m_plru_bits.begin(), m_plru_bits.end(), 0);
+        m_clock = 0;
+        m_seen.clear();
+        m_shadow.clear();
+        m_shadow_map.clear();
+        m_stats = statistics();
+    }
+
+private:
+    cache_config m_config;
+    uint64_t m_sets;
+    uint64_t m_lines;
+    uint64_t m_clock;
+    std::vector<uint64_t> m_tags;       // m_tags[set * ways + way]
+    std::vector<uint64_t> m_state;      // LRU timestamp or RRPV of each way
+    std::vector<uint8_t> m_plru_bits;   // ways - 1 tree bits per set (stride ways)
+    statistics m_stats;
+
+    // for the classification of the misses
+    std::unordered_set<uint64_t> m_seen;
+    std::list<uint64_t> m_shadow;  // fully-associative LRU, most recent first
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> m_shadow_map;
+
+    uint64_t find(uint64_t line) const {
+        uint64_t base = (line % m_sets) * m_config.ways;
+        for (uint64_t way = 0; way != m_config.ways; ++way) {
+            if (m_tags[base + way] == line) return base + way;
+        }
+        return invalid_line;
+    }
+
+    // on a hit, update the replacement state of the line
+    bool touch(uint64_t line) {
+        uint64_t slot = find(line);
+        if (slot == invalid_line) return false;
+        switch (m_config.policy) {
+            case replacement::lru:
+                m_state[slot] = ++m_clock;
+                break;
+            case replacement::plru:
+                plru_touch(line % m_sets, slot % m_config.ways);
+                break;
+            case replacement::rrip:
+                m_state[slot] = 0;
+                break;
+        }
+        return true;
+    }
+
+    uint64_t victim(uint64_t set) {
+        uint64_t base = set * m_config.ways;
+        for (uint64_t way = 0; way != m_config.ways; ++way) {
+            if (m_tags[base + way] == invalid_line) return way;
+        }
+        switch (m_config.policy) {
+            case replacement::lru: {
+                uint64_t way = 0;
+                for (uint64_t w = 1; w != m_config.ways; ++w) {
+                    if (m_state[base + w] < m_state[base + way]) way = w;
+                }
+                return way;
+            }
+            case replacement::plru: {
+                // follow the bits, that point away from the most recently used half
+                uint8_t const* bits = m_plru_bits.data() + base;
+                uint64_t node = 0;
+                while (node < m_config.ways - 1) node = 2 * node + 1 + bits[node];
+                return node - (m_config.ways - 1);
+            }
+            default: {
+                while (true) {
+                    for (uint64_t way = 0; way != m_config.ways; ++way) {
+                        if (m_state[base + way] == max_rrpv) return way;
+                    }
+                    for (uint64_t way = 0; way != m_config.ways; ++way) m_state[base + way] += 1;
+                }
+            }
+        }
+    }
+
+    // make the bits on the path to the way point to the other halves
+    void plru_touch(uint64_t set, uint64_t way) {
+        uint8_t* bits = m_plru_bits.data() + set * m_config.ways;
+        uint64_t node = way + m_config.ways - 1;
+        while (node) {
+            uint64_t parent = (node - 1) / 2;
+            bits[parent] = node == 2 * parent + 1;  // 1: go right next time
+            node = parent;
+        }
+    }
+
+    bool shadow_access(uint64_t line) {
+        auto it = m_shadow_map.find(line);
+        if (it != m_shadow_map.end()) {
+            m_shadow.splice(m_shadow.begin(), m_shadow, it->second);
+            return true;
+        }
+        m_shadow.push_front(line);
+        m_shadow_map[line] = m_shadow.begin();
+        if (m_shadow.size() > m_lines) {
+            m_shadow_map.erase(m_shadow.back());
+            m_shadow.pop_back();
+        }
+        return false;
+    }
+};
+
+struct cache_hierarchy {
+    cache_hierarchy(std::vector<cache_config> const& configs,
+                    inclusion policy = inclusion::inclusive)
+        : m_policy(policy), m_accesses(0) {
+        if (configs.empty()) throw std::runtime_error("a cache hierarchy needs a level");
+        for (auto const& config : configs) {
+            if (config.line_size != configs.front().line_size) {
+                throw std::runtime_error("all levels must have the same line size");
+            }
+            m_levels.emplace_back(config);
+        }
+    }
+
+    template <typename T>
+    void map(T const& x) {
+        access(reinterpret_cast<uint64_t>(&x) / m_levels.front().config().line_size);
+    }
+
+    void access(uint64_t line) {
+        m_accesses += 1;
+        uint64_t l = 0;
+        while (l != m_levels.size() and !m_levels[l].access(line)) ++l;
+        if (m_policy == inclusion::inclusive) {
+            // fill the levels above the one that hit (or all, from memory)
+            for (uint64_t k = l; k-- != 0;) {
+                uint64_t evicted = m_levels[k].fill(line);
+                if (evicted != cache_level::invalid_line) {
+                    for (uint64_t j = 0; j != k; ++j) m_levels[j].invalidate(evicted);
+                }
+            }
+        } else if (l != 0) {
+            // move the line to the first level, cascading the victims down
+            if (l != m_levels.size()) m_levels[l].invalidate(line);
+            uint64_t victim = line;
+            for (uint64_t k = 0; k != m_levels.size() and victim != cache_level::invalid_line;
+                 ++k) {
+                victim = m_levels[k].fill(victim);
+            }
+        }
+    }
+
+    cache_level const& level(uint64_t l) const {
+        return m_levels[l];
+    }
+
+    uint64_t levels() const {
+        return m_levels.size();
+    }
+
+    void print_stats() const {
+        static char const* policy_names[] = {"lru", "plru", "rrip"};
+        std::cout << "cache hierarchy ("
+                  << (m_policy == inclusion::inclusive ? "inclusive" : "exclusive") << "), "
+                  << m_accesses << " accesses:\n";
+        for (uint64_t l = 0; l != m_levels.size(); ++l) {
+            auto const& config = m_levels[l].config();
+            auto const& stats = m_levels[l].stats();
+            std::cout << "  L" << l + 1 << " (" << config.size / 1024 << " KiB, " << config.ways
+                      << " ways, " << policy_names[static_cast<int>(config.policy)]
+                      << "): accesses " << stats.accesses() << ", hits " << stats.hits
+                      << ", misses " << stats.misses() << " (compulsory " << stats.compulsory
+                      << ", capacity " << stats.capacity << ", conflict " << stats.conflict
+                      << "), miss ratio "
+                      << (stats.accesses() ? double(stats.misses()) / stats.accesses() : 0.0)
+                      << "\n";
+        }
+        std::cout << std::flush;
+    }
+
+    void clear() {
+        for (auto& level : m_levels) level.clear();
+        m_accesses = 0;
+    }
+
+private:
+    inclusion m_policy;
+    uint64_t m_accesses;
+    std::vector<cache_level> m_levels;
+};
@@ -1,5 +1,16 @@
 #pragma once
 
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <algorithm>
+
+/* The batched queries, sum(indices, n, out, c), answer the queries in groups of batch_group.
+   The queries of a group walk their paths in lockstep, if they have the same length, so that
+   the loads of a step are independent; otherwise the first nodes of the paths are prefetched
+   and the queries are answered one by one. */
+constexpr uint64_t batch_group = 16;
+
 template <typename T>
 void build_node_prefix_sums(T const* input, uint8_t* out, uint64_t segment_size, uint64_t bytes) {
     std::fill(out, out + bytes, 0);
@@ -14,3 +25,27 @@ void build_node_prefix_sums(T const* input, uint8_t* out, uint64_t segment_size,
         keys += segment_size;
     }
 }
+
+/* A batch of queries answered in increasing order of index, so that consecutive queries share
+   the nodes at the top of their paths; the results are in the order of the batch.
+   The indices are sorted together with their positions in the batch, in the low bits.
+   scratch is owned by the caller and only grows, so that a sequence of batches does not
+   allocate. */
+template <typename Tree, typename Cache>
+void sum_sorted(Tree& tree, uint64_t const* indices, uint64_t n, int64_t* out, Cache& c,
+                std::vector<uint64_t>& scratch) {
+    if (n == 0) return;
+    uint64_t bits = 64 - __builtin_clzll(n);
+    if (scratch.size() < 3 * n) scratch.resize(3 * n);
+    uint64_t* keys = scratch.data();
+    uint64_t* sorted = keys + n;
+    int64_t* sums = reinterpret_cast<int64_t*>(sorted + n);
+    for (uint64_t k = 0; k != n; ++k) {
+        assert(indices[k] >> (64 - bits) == 0);
+        keys[k] = indices[k] << bits | k;
+    }
+    std::sort(keys, keys + n);
+    for (uint64_t k = 0; k != n; ++k) sorted[k] = keys[k] >> bits;
+    tree.sum(sorted, n, sums, c);
+    for (uint64_t k = 0; k != n; ++k) out[keys[k] & ((uint64_t(1) << bits) - 1)] = sums[k];
+}
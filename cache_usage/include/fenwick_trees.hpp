@@ -2,6 +2,8 @@
 
 #include <vector>
 
+#include "common.hpp"
+
 struct fenwick_tree {
     fenwick_tree() : iterations(0), m_size(0) {}
 
@@ -15,7 +17,8 @@ struct fenwick_tree {
         }
     }
 
-    int64_t sum(uint64_t i, cache& c) {
+    template <typename Cache>
+    int64_t sum(uint64_t i, Cache& c) {
         int64_t sum = 0;
         for (++i; i != 0; i &= i - 1) {
             c.map(m_tree[i]);
@@ -25,12 +28,25 @@ struct fenwick_tree {
         return sum;
     }
 
-    // void update(uint64_t i, int64_t delta, cache& c) {
-    //     for (++i; i < size(); i += i & -i) {
-    //         c.map(m_tree[i]);
-    //         m_tree[i] += delta;
-    //     }
-    // }
+    /* The first nodes of the paths of a group of queries are prefetched, then the queries are
+       answered one by one. Interleaving the walks is slower: the paths have different
+       lengths, so the walks of a group take as many steps as the longest one. */
+    template <typename Cache>
+    void sum(uint64_t const* indices, uint64_t n, int64_t* out, Cache& c) {
+        for (uint64_t b = 0; b < n; b += batch_group) {
+            uint64_t m = std::min(batch_group, n - b);
+            for (uint64_t q = 0; q != m; ++q) __builtin_prefetch(&m_tree[indices[b + q] + 1]);
+            for (uint64_t q = 0; q != m; ++q) out[b + q] = sum(indices[b + q], c);
+        }
+    }
+
+    template <typename Cache>
+    void update(uint64_t i, int64_t delta, Cache& c) {
+        for (++i; i <= m_size; i += i & -i) {
+            c.map(m_tree[i]);
+            m_tree[i] += delta;
+        }
+    }
 
     uint64_t size() const {
         return m_tree.size();
@@ -56,7 +72,8 @@ struct fenwick_tree_holes {
         }
     }
 
-    int64_t sum(uint64_t i, cache& c) {
+    template <typename Cache>
+    int64_t sum(uint64_t i, Cache& c) {
         int64_t sum = 0;
         for (++i; i != 0; i &= i - 1) {
             c.map(m_tree[pos(i)]);
@@ -66,7 +83,18 @@ struct fenwick_tree_holes {
         return sum;
     }
 
-    void update(uint64_t i, int64_t delta, cache& c) {
+    // as in fenwick_tree
+    template <typename Cache>
+    void sum(uint64_t const* indices, uint64_t n, int64_t* out, Cache& c) {
+        for (uint64_t b = 0; b < n; b += batch_group) {
+            uint64_t m = std::min(batch_group, n - b);
+            for (uint64_t q = 0; q != m; ++q) __builtin_prefetch(&m_tree[pos(indices[b + q] + 1)]);
+            for (uint64_t q = 0; q != m; ++q) out[b + q] = sum(indices[b + q], c);
+        }
+    }
+
+    template <typename Cache>
+    void update(uint64_t i, int64_t delta, Cache& c) {
         for (++i; i <= m_size; i += i & -i) {
             c.map(m_tree[pos(i)]);
             m_tree[pos(i)] += delta;
@@ -116,9 +144,10 @@ struct fenwick_tree_blocked {
 
         std::vector<int64_t> node_data(Node::fanout);
 
-        m_data.resize(pos(m_blocks * Node::bytes));
-        m_ptr = m_data.data();
-        uint8_t* ptr = m_data.data();
+        // the nodes start on a cache line, so that no value of a node spans two lines
+        m_data.resize(pos(m_blocks * Node::bytes) + line_size);
+        m_ptr = m_data.data() + (line_size - uintptr_t(m_data.data()) % line_size) % line_size;
+        uint8_t* ptr = m_ptr;
         uint64_t size = 0;
         for (uint64_t i = 0, base = 0; i != m_blocks; ++i, base += Node::fanout) {
             node_data[0] = fenwick_tree_data[i];
@@ -161,8 +190,9 @@ struct fenwick_tree_blocked {
     //     return sum;
     // }
 
-    int64_t sum(uint64_t i, cache& c) {
-        assert(i < size());
+    template <typename Cache>
+    int64_t sum(uint64_t i, Cache& c) {
+        assert(i < m_size);
         uint64_t block = i / Node::fanout + 1;
         uint64_t offset = i % Node::fanout;
 
@@ -176,15 +206,47 @@ struct fenwick_tree_blocked {
         return sum;
     }
 
+    // as in fenwick_tree: the values read in the first node of each query are prefetched
+    template <typename Cache>
+    void sum(uint64_t const* indices, uint64_t n, int64_t* out, Cache& c) {
+        for (uint64_t b = 0; b < n; b += batch_group) {
+            uint64_t m = std::min(batch_group, n - b);
+            for (uint64_t q = 0; q != m; ++q) {
+                uint64_t block = indices[b + q] / Node::fanout;
+                Node(m_ptr + pos(block * Node::bytes)).prefetch(indices[b + q] % Node::fanout);
+            }
+            for (uint64_t q = 0; q != m; ++q) out[b + q] = sum(indices[b + q], c);
+        }
+    }
+
+    /* The prefix sums of the node of i change from the offset of i onwards; the nodes that
+       follow in the Fenwick tree of the blocks store the sum of the block of i, so all
+       their prefix sums change. */
+    template <typename Cache>
+    void update(uint64_t i, int64_t delta, Cache& c) {
+        assert(i < m_size);
+        uint64_t block = i / Node::fanout + 1;
+        c.map(m_ptr[pos((block - 1) * Node::bytes)]);
+        Node(m_ptr + pos((block - 1) * Node::bytes)).update(i % Node::fanout, delta, c);
+        for (block += block & -block; block <= m_blocks; block += block & -block) {
+            c.map(m_ptr[pos((block - 1) * Node::bytes)]);
+            Node(m_ptr + pos((block - 1) * Node::bytes)).update(0, delta, c);
+        }
+    }
+
     uint64_t iterations;
 
 private:
+    static constexpr uint64_t line_size = 64;
+    static_assert(Node::bytes % line_size == 0, "a node must take a multiple of cache lines");
+
     uint64_t m_blocks;
     uint64_t m_size;
-    uint8_t* m_ptr;
+    uint8_t* m_ptr;  // the first cache line of m_data
     std::vector<uint8_t> m_data;
 
+    // a hole of a cache line every 16 KiB (the nodes take a multiple of lines)
     static inline uint64_t pos(uint64_t i) {
-        return i + (i >> 14);
+        return i + ((i >> 14) << 6);
     }
 };
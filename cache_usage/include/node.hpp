@@ -0,0 +1,141 @@
+#pragma once
+
+#include <string>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <cassert>
+#include <stdexcept>
+
+#include "simd_add.hpp"
+
+/* A family of nodes for fenwick_tree_blocked, templated on the fanout (64, 256 or 1024)
+   and on the type of the keys (int16_t, int32_t or int64_t).
+
+   As in node64, the fanout values are divided into sqrt(fanout) segments of sqrt(fanout)
+   values. summary[s] is the (64-bit) prefix sum up to the first value of segment s,
+   included, and keys[i] is the sum of the values of the segment of i that follow the first
+   one, up to i: the first value of the node (that, in the blocked tree, is the sum of the
+   preceding blocks) is only in the summaries, so the keys only hold sums of
+   sqrt(fanout) - 1 values and can be narrow. sum(i) = summary[i / segment_size] + keys[i]
+   reads two values, i.e., at most two cache lines.
+
+   An update of value i adds delta to the keys that follow i in its segment (unless i is the
+   first of the segment) and to the summaries of the following segments: these are
+   contiguous ranges, added with vector instructions (see simd_add.hpp).
+   The keys must fit in Key: build throws if they do not, and so does an update that would
+   make a key overflow (before changing the node). */
+
+template <uint64_t Fanout, typename Key>
+struct node {
+    static_assert(Fanout == 64 or Fanout == 256 or Fanout == 1024, "unsupported fanout");
+    static_assert(std::is_signed_v<Key> and sizeof(Key) >= 2, "keys must be signed, 16-64 bits");
+
+    typedef Key key_type;
+    static constexpr uint64_t fanout = Fanout;
+    static constexpr uint64_t segment_size = Fanout == 64 ? 8 : Fanout == 256 ? 16 : 32;
+    static constexpr uint64_t segments = fanout / segment_size;
+    static constexpr uint64_t bytes = segments * sizeof(int64_t) + fanout * sizeof(Key);
+
+    node() {}  // do not initialize
+
+    template <typename T>
+    static void build(T const* input, uint8_t* out) {
+        int64_t* summary = reinterpret_cast<int64_t*>(out);
+        Key* keys = reinterpret_cast<Key*>(out + segments * sizeof(int64_t));
+        int64_t prefix = 0;
+        for (uint64_t s = 0; s != segments; ++s) {
+            uint64_t first = s * segment_size;
+            prefix += input[first];
+            summary[s] = prefix;
+            int64_t key = 0;
+            keys[first] = 0;
+            for (uint64_t i = first + 1; i != first + segment_size; ++i) {
+                key += input[i];
+                if (key < std::numeric_limits<Key>::min() or
+                    key > std::numeric_limits<Key>::max()) {
+                    throw std::runtime_error("the sums of a segment do not fit in " +
+                                             std::to_string(8 * sizeof(Key)) + " bits");
+                }
+                keys[i] = key;
+            }
+            prefix += key;
+        }
+    }
+
+    node(uint8_t* ptr) {
+        at(ptr);
+    }
+
+    inline void at(uint8_t* ptr) {
+        summary = reinterpret_cast<int64_t*>(ptr);
+        keys = reinterpret_cast<Key*>(ptr + segments * sizeof(int64_t));
+    }
+
+    template <typename Cache>
+    int64_t sum(uint64_t i, Cache& c) {
+        assert(i < fanout);
+        c.map(summary[i / segment_size]);
+        c.map(keys[i]);
+        return summary[i / segment_size] + keys[i];
+    }
+
+    // prefetch the summary and the key read by sum(i)
+    inline void prefetch(uint64_t i) const {
+        __builtin_prefetch(summary + i / segment_size);
+        __builtin_prefetch(keys + i);
+    }
+
+    // add delta to the prefix sums from i onwards
+    template <typename Cache>
+    void update(uint64_t i, int64_t delta, Cache& c) {
+        assert(i < fanout);
+        uint64_t segment = i / segment_size;
+        uint64_t end = (segment + 1) * segment_size;
+        if (i % segment_size == 0) {
+            map(summary + segment, segments - segment, c);
+            simd::add(summary + segment, segments - segment, delta);
+            return;
+        }
+        map(keys + i, end - i, c);
+        check_add(keys + i, end - i, delta);
+        simd::add(keys + i, end - i, Key(delta));
+        map(summary + segment + 1, segments - segment - 1, c);
+        simd::add(summary + segment + 1, segments - segment - 1, delta);
+    }
+
+private:
+    static constexpr uint64_t line_size = 64;
+
+    int64_t* summary;
+    Key* keys;
+
+    /* Throw if adding delta to the keys x[0, n) makes one of them overflow. The keys are not
+       monotone (values can be negative), so the extreme one is searched for. */
+    static void check_add(Key const* x, uint64_t n, int64_t delta) {
+        if constexpr (sizeof(Key) < sizeof(int64_t)) {
+            if (delta > 0) {
+                Key hi = x[0];
+                for (uint64_t j = 1; j != n; ++j) hi = std::max(hi, x[j]);
+                if (delta <= int64_t(std::numeric_limits<Key>::max()) - hi) return;
+            } else {
+                Key lo = x[0];
+                for (uint64_t j = 1; j != n; ++j) lo = std::min(lo, x[j]);
+                if (delta >= int64_t(std::numeric_limits<Key>::min()) - lo) return;
+            }
+            throw std::runtime_error("the sums of a segment do not fit in " +
+                                     std::to_string(8 * sizeof(Key)) + " bits");
+        }
+    }
+
+    // map the cache lines of x[0, n)
+    template <typename T, typename Cache>
+    static void map(T const* x, uint64_t n, Cache& c) {
+        if (n == 0) return;
+        uint8_t const* begin = reinterpret_cast<uint8_t const*>(x);
+        uint8_t const* end = begin + n * sizeof(T);
+        c.map(*begin);
+        uint8_t const* p = begin + (line_size - reinterpret_cast<uintptr_t>(begin) % line_size);
+        for (; p < end; p += line_size) c.map(*p);
+    }
+};
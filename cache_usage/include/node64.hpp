@@ -24,13 +24,36 @@ struct node64 {
         keys = reinterpret_cast<int64_t*>(ptr + segment_size * sizeof(int64_t));
     }
 
-    int64_t sum(uint64_t i, cache& c) {
+    template <typename Cache>
+    int64_t sum(uint64_t i, Cache& c) {
         assert(i < fanout);
         c.map(summary[i / segment_size]);
         c.map(keys[i]);
         return summary[i / segment_size] + keys[i];
     }
 
+    // prefetch the summary and the key read by sum(i)
+    inline void prefetch(uint64_t i) const {
+        __builtin_prefetch(summary + i / segment_size);
+        __builtin_prefetch(keys + i);
+    }
+
+    // add delta to the prefix sums from i onwards: the rest of the segment of i
+    // and the summaries of the following segments
+    template <typename Cache>
+    void update(uint64_t i, int64_t delta, Cache& c) {
+        assert(i < fanout);
+        uint64_t segment = i / segment_size;
+        for (uint64_t s = segment + 1; s != fanout / segment_size; ++s) {
+            c.map(summary[s]);
+            summary[s] += delta;
+        }
+        for (uint64_t k = i; k != (segment + 1) * segment_size; ++k) {
+            c.map(keys[k]);
+            keys[k] += delta;
+        }
+    }
+
 private:
     int64_t* summary;
     int64_t* keys;
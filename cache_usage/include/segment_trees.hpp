@@ -2,6 +2,9 @@
 
 #include <vector>
 
+#include "common.hpp"
+#include "simd_add.hpp"
+
 struct segment_tree_topdown {
     segment_tree_topdown() : iterations(0), m_size(0) {}
 
@@ -14,7 +17,8 @@ struct segment_tree_topdown {
         build(in.data(), 0, m_size - 1, 0);
     }
 
-    int64_t sum(uint64_t i, cache& c) {
+    template <typename Cache>
+    int64_t sum(uint64_t i, Cache& c) {
         uint64_t l = 0;
         uint64_t h = m_size - 1;
         uint64_t p = 0;
@@ -37,6 +41,62 @@ struct segment_tree_topdown {
         return sum + m_tree[p];
     }
 
+    /* The queries of a group descend in lockstep, without branches, down to the leaves:
+       a query that would stop at node p (when i is the last leaf of p) goes on along the
+       rightmost path of p, whose left children and leaf sum to the value of p.
+       The children of each node are prefetched before the next step. */
+    template <typename Cache>
+    void sum(uint64_t const* indices, uint64_t n, int64_t* out, Cache& c) {
+        uint64_t levels = 63 - __builtin_clzll(m_size);
+        for (uint64_t b = 0; b < n; b += batch_group) {
+            uint64_t m = std::min(batch_group, n - b);
+            uint64_t p[batch_group];
+            int64_t sums[batch_group];
+            for (uint64_t q = 0; q != m; ++q) {
+                p[q] = 0;
+                sums[q] = 0;
+                // the iterations of sum(i), that stops at the last node whose last leaf is i
+                uint64_t ones = std::min<uint64_t>(__builtin_ctzll(~indices[b + q]), levels);
+                iterations += levels - ones + (ones != 0);
+            }
+            for (uint64_t bit = levels; bit-- != 0;) {
+                for (uint64_t q = 0; q != m; ++q) {
+                    uint64_t right = (indices[b + q] >> bit) & 1;
+                    p[q] = 2 * p[q] + 1;
+                    if (right) c.map(m_tree[p[q]]);
+                    sums[q] += m_tree[p[q]] & -int64_t(right);
+                    p[q] += right;
+                    __builtin_prefetch(m_tree.data() + 2 * p[q] + 1);
+                }
+            }
+            for (uint64_t q = 0; q != m; ++q) {
+                c.map(m_tree[p[q]]);
+                out[b + q] = sums[q] + m_tree[p[q]];
+            }
+        }
+    }
+
+    // add delta to the nodes on the path from the root to the leaf of i
+    template <typename Cache>
+    void update(uint64_t i, int64_t delta, Cache& c) {
+        uint64_t l = 0;
+        uint64_t h = m_size - 1;
+        uint64_t p = 0;
+        while (true) {
+            c.map(m_tree[p]);
+            m_tree[p] += delta;
+            if (l == h) break;
+            uint64_t m = (l + h) / 2;
+            if (i > m) {
+                p = 2 * p + 2;
+                l = m + 1;
+            } else {
+                p = 2 * p + 1;
+                h = m;
+            }
+        }
+    }
+
     uint64_t size() const {
         return m_tree.size();
     }
@@ -71,7 +131,8 @@ struct segment_tree_bottomup {
         build(0);
     }
 
-    int64_t sum(uint64_t i, cache& c) {
+    template <typename Cache>
+    int64_t sum(uint64_t i, Cache& c) {
         uint64_t p = m_begin + i;
         p -= (p >= m_tree.size()) * m_size;
         int64_t sum = m_tree[p];
@@ -86,6 +147,51 @@ struct segment_tree_bottomup {
         return sum;
     }
 
+    /* The leaves are at depth d or d - 1, where d = log2(m_begin + 1), so the queries of a
+       group climb in lockstep for d steps, without branches: a query that reached the root
+       stays there and adds nothing. The parents are prefetched before the next step. */
+    template <typename Cache>
+    void sum(uint64_t const* indices, uint64_t n, int64_t* out, Cache& c) {
+        uint64_t depth = 63 - __builtin_clzll(m_begin + 1);
+        for (uint64_t b = 0; b < n; b += batch_group) {
+            uint64_t m = std::min(batch_group, n - b);
+            uint64_t p[batch_group];
+            int64_t sums[batch_group];
+            for (uint64_t q = 0; q != m; ++q) {
+                p[q] = m_begin + indices[b + q];
+                p[q] -= (p[q] >= m_tree.size()) * m_size;
+                sums[q] = m_tree[p[q]];
+                iterations += 63 - __builtin_clzll(p[q] + 1);  // the depth of the leaf
+            }
+            for (uint64_t step = 0; step != depth; ++step) {
+                for (uint64_t q = 0; q != m; ++q) {
+                    // p - 1 is the left sibling of p if p is a right child, and (p - 1) / 2
+                    // is the parent of p
+                    uint64_t prev = p[q] - (p[q] != 0);
+                    bool right = p[q] != 0 and (p[q] & 1) == 0;
+                    if (right) c.map(m_tree[prev]);
+                    sums[q] += m_tree[prev] & -int64_t(right);
+                    p[q] = prev / 2;
+                    __builtin_prefetch(m_tree.data() + p[q] - (p[q] != 0));
+                }
+            }
+            for (uint64_t q = 0; q != m; ++q) out[b + q] = sums[q];
+        }
+    }
+
+    // add delta to the nodes on the path from the leaf of i to the root
+    template <typename Cache>
+    void update(uint64_t i, int64_t delta, Cache& c) {
+        uint64_t p = m_begin + i;
+        p -= (p >= m_tree.size()) * m_size;
+        while (true) {
+            c.map(m_tree[p]);
+            m_tree[p] += delta;
+            if (p == 0) break;
+            p = (p - 1) / 2;
+        }
+    }
+
     uint64_t size() const {
         return m_tree.size();
     }
@@ -103,4 +209,341 @@ private:
         int64_t r_sum = build(2 * p + 2);
         return m_tree[p] = l_sum + r_sum;
     }
-};
\ No newline at end of file
+};
+/* The segment trees below have alternative layouts of the nodes in memory, to reduce the
+   number of cache lines read by a query [Khuong and Morin, "Array layouts for
+   comparison-based searching", JEA 2017]. The first two are perfect binary trees with
+   2^k leaves (padded with zeros); all the arrays start on a cache line. */
+
+namespace detail {
+
+// a pointer to the first cache line of v, that must have 7 more elements than needed
+inline int64_t* first_line(std::vector<int64_t>& v) {
+    uintptr_t misalignment = reinterpret_cast<uintptr_t>(v.data()) % 64;
+    return v.data() + (misalignment ? (64 - misalignment) / sizeof(int64_t) : 0);
+}
+
+}  // namespace detail
+
+/* Eytzinger (BFS) layout, 1-based: the children of node k are 2k and 2k + 1, so the 16
+   descendants of k four levels below are contiguous (from 16k) and take two cache lines,
+   that are prefetched while descending. */
+struct segment_tree_eytzinger {
+    segment_tree_eytzinger() : iterations(0), m_leaves(0), m_levels(0), m_tree(nullptr) {}
+
+    template <typename T>
+    void build(T const* input, uint64_t n) {
+        m_levels = static_cast<uint64_t>(ceil(log2(n))) + 1;
+        m_leaves = uint64_t(1) << (m_levels - 1);
+        m_data.assign(2 * m_leaves + 7, 0);
+        m_tree = detail::first_line(m_data);
+        std::copy(input, input + n, m_tree + m_leaves);
+        for (uint64_t k = m_leaves - 1; k != 0; --k) m_tree[k] = m_tree[2 * k] + m_tree[2 * k + 1];
+    }
+
+    template <typename Cache>
+    int64_t sum(uint64_t i, Cache& c) {
+        uint64_t k = 1;
+        int64_t sum = 0;
+        for (uint64_t bit = m_levels - 1; bit-- != 0;) {
+            iterations += 1;
+            if (16 * k < 2 * m_leaves) __builtin_prefetch(m_tree + 16 * k);
+            // branch-free: the left child is in the same cache line as the right one
+            uint64_t right = (i >> bit) & 1;
+            c.map(m_tree[2 * k]);
+            sum += m_tree[2 * k] & -int64_t(right);
+            k = 2 * k + right;
+        }
+        c.map(m_tree[k]);
+        return sum + m_tree[k];
+    }
+
+    /* All the queries of a group have the same depth, so they descend level by level:
+       the nodes of a level are prefetched for the whole group before being read. */
+    template <typename Cache>
+    void sum(uint64_t const* indices, uint64_t n, int64_t* out, Cache& c) {
+        for (uint64_t b = 0; b < n; b += batch_group) {
+            uint64_t m = std::min(batch_group, n - b);
+            uint64_t k[batch_group];
+            int64_t sums[batch_group];
+            for (uint64_t q = 0; q != m; ++q) {
+                k[q] = 1;
+                sums[q] = 0;
+            }
+            for (uint64_t bit = m_levels - 1; bit-- != 0;) {
+                for (uint64_t q = 0; q != m; ++q) __builtin_prefetch(m_tree + 2 * k[q]);
+                for (uint64_t q = 0; q != m; ++q) {
+                    uint64_t right = (indices[b + q] >> bit) & 1;
+                    c.map(m_tree[2 * k[q]]);
+                    sums[q] += m_tree[2 * k[q]] & -int64_t(right);
+                    k[q] = 2 * k[q] + right;
+                }
+            }
+            for (uint64_t q = 0; q != m; ++q) __builtin_prefetch(m_tree + k[q]);
+            for (uint64_t q = 0; q != m; ++q) {
+                c.map(m_tree[k[q]]);
+                out[b + q] = sums[q] + m_tree[k[q]];
+            }
+            iterations += m * (m_levels - 1);
+        }
+    }
+
+    template <typename Cache>
+    void update(uint64_t i, int64_t delta, Cache& c) {
+        for (uint64_t k = m_leaves + i; k != 0; k /= 2) {
+            c.map(m_tree[k]);
+            m_tree[k] += delta;
+        }
+    }
+
+    uint64_t size() const {
+        return 2 * m_leaves;
+    }
+
+    uint64_t iterations;
+
+private:
+    uint64_t m_leaves, m_levels;
+    int64_t* m_tree;  // the first cache line of m_data
+    std::vector<int64_t> m_data;
+};
+
+/* van Emde Boas layout: a tree of height h is laid out as its top tree, of height h / 2,
+   followed by the bottom trees, of height h - h / 2, each laid out recursively
+   [Prokop, MIT MSc thesis, 1999]. The position of a node is computed while descending
+   from the positions of its ancestors, as in [Brodal, Fagerberg and Jacob, SODA 2002]:
+   a node of depth d (with BFS index k, 1-based) is the root of one of the bottom trees
+   below a top tree rooted at depth top_depth, hence its position is
+   pos[top_depth] + top_size + (k & top_size) * bottom_size, where the three values only
+   depend on d. In particular, the left sibling of a node is bottom_size positions before. */
+struct segment_tree_veb {
+    static constexpr uint64_t max_levels = 64;
+
+    segment_tree_veb() : iterations(0), m_leaves(0), m_levels(0), m_tree(nullptr) {}
+
+    template <typename T>
+    void build(T const* input, uint64_t n) {
+        m_levels = static_cast<uint64_t>(ceil(log2(n))) + 1;
+        m_leaves = uint64_t(1) << (m_levels - 1);
+        split(0, m_levels);
+        m_data.assign(2 * m_leaves - 1 + 7, 0);
+        m_tree = detail::first_line(m_data);
+        uint64_t pos[max_levels];
+        pos[0] = 0;
+        build(input, n, 1, 0, pos);
+    }
+
+    template <typename Cache>
+    int64_t sum(uint64_t i, Cache& c) {
+        uint64_t pos[max_levels];
+        pos[0] = 0;
+        uint64_t k = 1;
+        int64_t sum = 0;
+        for (uint64_t d = 1; d != m_levels; ++d) {
+            iterations += 1;
+            uint64_t bit = (i >> (m_levels - 1 - d)) & 1;
+            k = 2 * k + bit;
+            pos[d] = position(k, d, pos);
+            if (bit) {
+                uint64_t left = pos[d] - m_depths[d].bottom_size;
+                c.map(m_tree[left]);
+                sum += m_tree[left];
+            }
+        }
+        c.map(m_tree[pos[m_levels - 1]]);
+        return sum + m_tree[pos[m_levels - 1]];
+    }
+
+    // level by level and without branches, as in segment_tree_eytzinger
+    template <typename Cache>
+    void sum(uint64_t const* indices, uint64_t n, int64_t* out, Cache& c) {
+        for (uint64_t b = 0; b < n; b += batch_group) {
+            uint64_t m = std::min(batch_group, n - b);
+            uint64_t pos[batch_group][max_levels], k[batch_group];
+            int64_t sums[batch_group];
+            for (uint64_t q = 0; q != m; ++q) {
+                pos[q][0] = 0;
+                k[q] = 1;
+                sums[q] = 0;
+            }
+            for (uint64_t d = 1; d != m_levels; ++d) {
+                uint64_t shift = m_levels - 1 - d, bottom_size = m_depths[d].bottom_size;
+                for (uint64_t q = 0; q != m; ++q) {
+                    uint64_t right = (indices[b + q] >> shift) & 1;
+                    k[q] = 2 * k[q] + right;
+                    pos[q][d] = position(k[q], d, pos[q]);
+                    uint64_t left = pos[q][d] - (bottom_size & -right);  // pos[q][d] if left
+                    if (right) c.map(m_tree[left]);
+                    sums[q] += m_tree[left] & -int64_t(right);
+                }
+            }
+            for (uint64_t q = 0; q != m; ++q) {
+                c.map(m_tree[pos[q][m_levels - 1]]);
+                out[b + q] = sums[q] + m_tree[pos[q][m_levels - 1]];
+            }
+            iterations += m * (m_levels - 1);
+        }
+    }
+
+    template <typename Cache>
+    void update(uint64_t i, int64_t delta, Cache& c) {
+        uint64_t pos[max_levels];
+        pos[0] = 0;
+        c.map(m_tree[0]);
+        m_tree[0] += delta;
+        for (uint64_t d = 1, k = 1; d != m_levels; ++d) {
+            k = 2 * k + ((i >> (m_levels - 1 - d)) & 1);
+            pos[d] = position(k, d, pos);
+            c.map(m_tree[pos[d]]);
+            m_tree[pos[d]] += delta;
+        }
+    }
+
+    uint64_t size() const {
+        return 2 * m_leaves - 1;
+    }
+
+    uint64_t iterations;
+
+private:
+    uint64_t m_leaves, m_levels;
+    int64_t* m_tree;  // the first cache line of m_data
+    std::vector<int64_t> m_data;
+
+    struct depth_info {
+        uint64_t top_depth, top_size, bottom_size;
+    };
+    depth_info m_depths[max_levels];  // indexed by depth
+
+    inline uint64_t position(uint64_t k, uint64_t d, uint64_t const* pos) const {
+        depth_info const& x = m_depths[d];
+        return pos[x.top_depth] + x.top_size + (k & x.top_size) * x.bottom_size;
+    }
+
+    // the tree of the given height rooted at the given depth
+    void split(uint64_t depth, uint64_t height) {
+        if (height == 1) return;
+        uint64_t top = height / 2, bottom = height - top;
+        m_depths[depth + top] = {depth, (uint64_t(1) << top) - 1, (uint64_t(1) << bottom) - 1};
+        split(depth, top);
+        split(depth + top, bottom);
+    }
+
+    // build the subtree of node k, of depth d, whose position is pos[d]
+    template <typename T>
+    int64_t build(T const* input, uint64_t n, uint64_t k, uint64_t d, uint64_t* pos) {
+        int64_t sum = 0;
+        if (d + 1 == m_levels) {
+            uint64_t i = k - m_leaves;
+            sum = i < n ? input[i] : 0;
+        } else {
+            pos[d + 1] = position(2 * k, d + 1, pos);
+            sum += build(input, n, 2 * k, d + 1, pos);
+            pos[d + 1] = position(2 * k + 1, d + 1, pos);
+            sum += build(input, n, 2 * k + 1, d + 1, pos);
+        }
+        return m_tree[pos[d]] = sum;
+    }
+};
+
+/* B-ary layout, with a node of B = 8 values per cache line: node q of level l covers the
+   children 8q, ..., 8q + 7 of level l - 1 (the values of the input for level 0).
+   The values of a node are the prefix sums of its children, inclusive at level 0 and
+   exclusive at the other levels, so that a query reads one value per level.
+   The levels are stored from the root down. */
+struct segment_tree_bary {
+    static constexpr uint64_t B = 8;
+
+    segment_tree_bary() : iterations(0), m_size(0), m_tree(nullptr) {}
+
+    template <typename T>
+    void build(T const* input, uint64_t n) {
+        m_size = n;
+        std::vector<uint64_t> nodes;  // per level, from the leaves
+        for (uint64_t m = n; nodes.empty() or m > 1;) {
+            m = (m + B - 1) / B;
+            nodes.push_back(m);
+        }
+        m_offsets.assign(nodes.size(), 0);
+        uint64_t total = 0;
+        for (uint64_t l = nodes.size(); l-- != 0;) {
+            m_offsets[l] = total;
+            total += nodes[l] * B;
+        }
+        m_data.assign(total + 7, 0);
+        m_tree = detail::first_line(m_data);
+
+        std::vector<int64_t> totals(input, input + n), next;
+        for (uint64_t l = 0; l != nodes.size(); ++l) {
+            next.assign(nodes[l], 0);
+            int64_t* values = m_tree + m_offsets[l];
+            for (uint64_t i = 0; i != totals.size(); ++i) {
+                // inclusive at level 0, exclusive above
+                values[i] = next[i / B] + (l == 0 ? totals[i] : 0);
+                next[i / B] += totals[i];
+            }
+            for (uint64_t i = totals.size(); i != nodes[l] * B; ++i) values[i] = next[i / B];
+            totals.swap(next);
+        }
+    }
+
+    template <typename Cache>
+    int64_t sum(uint64_t i, Cache& c) {
+        int64_t sum = 0;
+        for (uint64_t l = 0, j = i; l != m_offsets.size(); ++l, j /= B) {
+            iterations += 1;
+            c.map(m_tree[m_offsets[l] + j]);
+            sum += m_tree[m_offsets[l] + j];
+        }
+        return sum;
+    }
+
+    // level by level, as in segment_tree_eytzinger
+    template <typename Cache>
+    void sum(uint64_t const* indices, uint64_t n, int64_t* out, Cache& c) {
+        for (uint64_t b = 0; b < n; b += batch_group) {
+            uint64_t m = std::min(batch_group, n - b);
+            uint64_t j[batch_group];
+            int64_t sums[batch_group];
+            for (uint64_t q = 0; q != m; ++q) {
+                j[q] = indices[b + q];
+                sums[q] = 0;
+            }
+            for (uint64_t l = 0; l != m_offsets.size(); ++l) {
+                int64_t const* values = m_tree + m_offsets[l];
+                for (uint64_t q = 0; q != m; ++q) __builtin_prefetch(values + j[q]);
+                for (uint64_t q = 0; q != m; ++q) {
+                    c.map(values[j[q]]);
+                    sums[q] += values[j[q]];
+                    j[q] /= B;
+                }
+            }
+            for (uint64_t q = 0; q != m; ++q) out[b + q] = sums[q];
+            iterations += m * m_offsets.size();
+        }
+    }
+
+    // add delta to the values that follow i in its node, at each level
+    template <typename Cache>
+    void update(uint64_t i, int64_t delta, Cache& c) {
+        for (uint64_t l = 0, j = i; l != m_offsets.size(); ++l, j /= B) {
+            uint64_t first = l == 0 ? j : j + 1;  // the first value that includes i
+            uint64_t end = (j / B + 1) * B;
+            if (first == end) continue;
+            c.map(m_tree[m_offsets[l] + first]);
+            simd::add(m_tree + m_offsets[l] + first, end - first, delta);
+        }
+    }
+
+    uint64_t size() const {
+        return m_data.size() - 7;
+    }
+
+    uint64_t iterations;
+
+private:
+    uint64_t m_size;
+    int64_t* m_tree;                  // the first cache line of m_data
+    std::vector<uint64_t> m_offsets;  // the offset of the values of each level
+    std::vector<int64_t> m_data;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <immintrin.h>
+
+/* Vectorized addition of a constant to an array of 16, 32 or 64-bit signed integers,
+   as needed by the updates of the nodes of fenwick_tree_blocked.
+
+   One kernel per ISA level is compiled with the corresponding target attribute, so that
+   the code does not depend on -march. The fastest kernel supported by the running CPU is
+   selected once at startup via CPUID and can be overridden with simd::use. */
+
+namespace simd {
+
+enum class isa { scalar, avx2, avx512 };
+
+static const isa all_isas[] = {isa::scalar, isa::avx2, isa::avx512};
+
+namespace detail {
+
+template <typename T>
+inline void add_scalar(T* x, uint64_t n, T delta) {
+    for (uint64_t i = 0; i != n; ++i) x[i] += delta;
+}
+
+template <typename T>
+__attribute__((target("avx2"))) inline void add_avx2(T* x, uint64_t n, T delta) {
+    static_assert(std::is_signed_v<T> and (sizeof(T) == 2 or sizeof(T) == 4 or sizeof(T) == 8));
+    constexpr uint64_t lanes = 32 / sizeof(T);
+    __m256i d;
+    if constexpr (sizeof(T) == 2) {
+        d = _mm256_set1_epi16(delta);
+    } else if constexpr (sizeof(T) == 4) {
+        d = _mm256_set1_epi32(delta);
+    } else {
+        d = _mm256_set1_epi64x(delta);
+    }
+    uint64_t i = 0;
+    for (uint64_t end = n - n % lanes; i != end; i += lanes) {
+        __m256i* p = reinterpret_cast<__m256i*>(x + i);
+        __m256i v = _mm256_loadu_si256(p);
+        if constexpr (sizeof(T) == 2) {
+            v = _mm256_add_epi16(v, d);
+        } else if constexpr (sizeof(T) == 4) {
+            v = _mm256_add_epi32(v, d);
+        } else {
+            v = _mm256_add_epi64(v, d);
+        }
+        _mm256_storeu_si256(p, v);
+    }
+    for (; i < n; ++i) x[i] += delta;
+}
+
+// the tail is added with a masked operation, without any scalar code
+template <typename T>
+__attribute__((target("avx512f,avx512bw"))) inline void add_avx512(T* x, uint64_t n, T delta) {
+    static_assert(std::is_signed_v<T> and (sizeof(T) == 2 or sizeof(T) == 4 or sizeof(T) == 8));
+    constexpr uint64_t lanes = 64 / sizeof(T);
+    for (uint64_t i = 0; i < n; i += lanes) {
+        uint64_t m = n - i < lanes ? n - i : lanes;
+        __mmask64 mask = m == 64 ? ~uint64_t(0) : (uint64_t(1) << m) - 1;
+        if constexpr (sizeof(T) == 2) {
+            __m512i v = _mm512_maskz_loadu_epi16(mask, x + i);
+            v = _mm512_add_epi16(v, _mm512_set1_epi16(delta));
+            _mm512_mask_storeu_epi16(x + i, mask, v);
+        } else if constexpr (sizeof(T) == 4) {
+            __m512i v = _mm512_maskz_loadu_epi32(mask, x + i);
+            v = _mm512_add_epi32(v, _mm512_set1_epi32(delta));
+            _mm512_mask_storeu_epi32(x + i, mask, v);
+        } else {
+            __m512i v = _mm512_maskz_loadu_epi64(mask, x + i);
+            v = _mm512_add_epi64(v, _mm512_set1_epi64(delta));
+            _mm512_mask_storeu_epi64(x + i, mask, v);
+        }
+    }
+}
+
+}  // namespace detail
+
+inline char const* name(isa level) {
+    switch (level) {
+        case isa::avx2:
+            return "avx2";
+        case isa::avx512:
+            return "avx512";
+        default:
+            return "scalar";
+    }
+}
+
+inline bool supported(isa level) {
+    __builtin_cpu_init();
+    switch (level) {
+        case isa::avx2:
+            return __builtin_cpu_supports("avx2");
+        case isa::avx512:
+            return __builtin_cpu_supports("avx512f") and __builtin_cpu_supports("avx512bw");
+        default:
+            return true;
+    }
+}
+
+inline isa detect() {
+    if (supported(isa::avx512)) return isa::avx512;
+    if (supported(isa::avx2)) return isa::avx2;
+    return isa::scalar;
+}
+
+inline isa active = detect();  // initialized at startup
+
+/* Select the kernels of the given ISA level (falls back to scalar
+   if the level is not supported by the CPU). */
+inline void use(isa level) {
+    active = supported(level) ? level : isa::scalar;
+}
+
+inline isa current() {
+    return active;
+}
+
+// x[i] += delta, for i in [0, n)
+template <typename T>
+inline void add(T* x, uint64_t n, T delta) {
+    switch (active) {
+        case isa::avx512:
+            detail::add_avx512(x, n, delta);
+            break;
+        case isa::avx2:
+            detail::add_avx2(x, n, delta);
+            break;
+        default:
+            detail::add_scalar(x, n, delta);
+    }
+}
+
+}  // namespace simd
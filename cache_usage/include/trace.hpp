@@ -0,0 +1,327 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "cache.hpp"
+
+/* Recording of the cache lines accessed by a data structure, and their offline replay.
+
+   - trace_writer has the same map method as cache, so it can be passed wherever a cache
+     is. It appends each accessed line to a binary file, encoded as its difference with the
+     previous line (zigzag-encoded, so that small negative differences are small too) in
+     LEB128: the accesses of a search are mostly close to each other and take 1-3 bytes.
+     The file starts with a header of 3 words: a magic number, the line size and the number
+     of accesses (written when the trace is closed).
+   - trace_reader decodes a trace file, reading it in blocks.
+   - stack_distance_profile computes, in one pass over a trace, the misses of the LRU caches
+     of all sizes and associativities by the stack algorithm [Mattson et al., IBM Systems
+     Journal 1970]: an access hits in a cache of W ways iff fewer than W distinct lines of
+     its set were accessed since the previous access to its line (its stack distance).
+     For the fully-associative caches, the distance is the number of lines whose last
+     access is after the previous access to the line: the last accesses are marked in a
+     Fenwick tree indexed by time [Olken, LBL-12370, 1981]. For the set-associative caches,
+     the distance is the position of the line in the recency list of its set, up to
+     max_ways, for every power-of-2 number of sets up to max_sets. */
+
+namespace trace {
+constexpr uint64_t magic = 0x31656361727463;  // "ctrace1"
+constexpr uint64_t buffer_size = uint64_t(1) << 16;
+}  // namespace trace
+
+struct trace_writer {
+    trace_writer(std::string const& filename, uint64_t line_size = LINE_SIZE)
+        : m_line_size(line_size), m_accesses(0), m_bytes(0), m_last(0) {
+        m_out.open(filename, std::ios::binary);
+        if (!m_out) throw std::runtime_error("cannot open trace file '" + filename + "'");
+        write_header();
+        m_buffer.reserve(trace::buffer_size + 10);
+    }
+
+    ~trace_writer() {
+        close();
+    }
+
+    template <typename T>
+    void map(T const& x) {
+        access(reinterpret_cast<uint64_t>(&x) / m_line_size);
+    }
+
+    void access(uint64_t line) {
+        uint64_t delta = line - m_last;
+        uint64_t zigzag = (delta << 1) ^ uint64_t(int64_t(delta) >> 63);
+        m_last = line;
+        while (zigzag >= 128) {
+            m_buffer.push_back(uint8_t(zigzag) | 128);
+            zigzag >>= 7;
+        }
+        m_buffer.push_back(zigzag);
+        m_accesses += 1;
+        if (m_buffer.size() >= trace::buffer_size) flush();
+    }
+
+    // write the buffered accesses and the final header
+    void close() {
+        if (!m_out.is_open()) return;
+        flush();
+        m_out.seekp(0);
+        write_header();
+        m_out.close();
+    }
+
+    uint64_t accesses() const {
+        return m_accesses;
+    }
+
+    // size of the encoded accesses (without the header)
+    uint64_t bytes() const {
+        return m_bytes + m_buffer.size();
+    }
+
+private:
+    std::ofstream m_out;
+    uint64_t m_line_size;
+    uint64_t m_accesses;
+    uint64_t m_bytes;  // flushed
+    uint64_t m_last;
+    std::vector<uint8_t> m_buffer;
+
+    void write_header() {
+        uint64_t header[3] = {trace::magic, m_line_size, m_accesses};
+        m_out.write(reinterpret_cast<char const*>(header), sizeof(header));
+    }
+
+    void flush() {
+        m_out.write(reinterpret_cast<char const*>(m_buffer.data()), m_buffer.size());
+        m_bytes += m_buffer.size();
+        m_buffer.clear();
+    }
+};
+
+struct trace_reader {
+    trace_reader(std::string const& filename) : m_pos(0), m_read(0), m_last(0) {
+        m_in.open(filename, std::ios::binary);
+        if (!m_in) throw std::runtime_error("cannot open trace file '" + filename + "'");
+        uint64_t header[3] = {0, 0, 0};
+        m_in.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!m_in or header[0] != trace::magic) {
+            throw std::runtime_error("'" + filename + "' is not a trace file");
+        }
+        m_line_size = header[1];
+        m_accesses = header[2];
+    }
+
+    uint64_t line_size() const {
+        return m_line_size;
+    }
+
+    uint64_t accesses() const {
+        return m_accesses;
+    }
+
+    bool done() const {
+        return m_read == m_accesses;
+    }
+
+    uint64_t next() {
+        uint64_t zigzag = 0;
+        for (uint64_t shift = 0;; shift += 7) {
+            uint8_t byte = next_byte();
+            zigzag |= uint64_t(byte & 127) << shift;
+            if (byte < 128) break;
+        }
+        m_last += (zigzag >> 1) ^ -(zigzag & 1);
+        m_read += 1;
+        return m_last;
+    }
+
+    // call f on the remaining accesses
+    template <typename F>
+    void for_each(F f) {
+        while (!done()) f(next());
+    }
+
+private:
+    std::ifstream m_in;
+    uint64_t m_line_size;
+    uint64_t m_accesses;
+    uint64_t m_pos;
+    uint64_t m_read;
+    uint64_t m_last;
+    std::vector<uint8_t> m_buffer;
+
+    uint8_t next_byte() {
+        if (m_pos == m_buffer.size()) {
+            m_buffer.resize(trace::buffer_size);
+            m_in.read(reinterpret_cast<char*>(m_buffer.data()), m_buffer.size());
+            m_buffer.resize(m_in.gcount());
+            m_pos = 0;
+            if (m_buffer.empty()) throw std::runtime_error("truncated trace file");
+        }
+        return m_buffer[m_pos++];
+    }
+};
+
+struct stack_distance_profile {
+    stack_distance_profile(uint64_t line_size = LINE_SIZE, uint64_t max_sets = 1 << 16,
+                           uint64_t max_ways = 16)
+        : m_line_size(line_size), m_max_ways(max_ways), m_accesses(0), m_cold(0) {
+        if (max_sets == 0 or (max_sets & (max_sets - 1)) != 0 or max_ways == 0) {
+            throw std::runtime_error("max_sets must be a power of 2 and max_ways positive");
+        }
+        for (uint64_t sets = 1; sets <= max_sets; sets *= 2) {
+            m_levels.push_back({std::vector<uint64_t>(sets * max_ways, invalid_line),
+                                std::vector<uint64_t>(max_ways + 1, 0)});
+        }
+    }
+
+    // the profile of the accesses of the trace (a trace of n accesses takes 4n bytes)
+    void replay(trace_reader& trace) {
+        if (trace.line_size() != m_line_size) {
+            throw std::runtime_error("the trace has a different line size");
+        }
+        clear();
+        m_marks.assign(trace.accesses() + 1, 0);
+        trace.for_each([&](uint64_t line) { access(line); });
+    }
+
+    uint64_t accesses() const {
+        return m_accesses;
+    }
+
+    uint64_t distinct_lines() const {
+        return m_cold;
+    }
+
+    /* Number of misses of an LRU cache of the given size (in bytes) and number of ways,
+       ways = 0 meaning fully associative. */
+    uint64_t misses(uint64_t size, uint64_t ways = 0) const {
+        uint64_t lines = size / m_line_size;
+        uint64_t hits = 0;
+        if (ways == 0) {
+            for (uint64_t d = 0; d < std::min<uint64_t>(lines, m_distances.size()); ++d) {
+                hits += m_distances[d];
+            }
+            return m_accesses - hits;
+        }
+        uint64_t sets = lines / ways;
+        if (!supported(size, ways)) {
+            throw std::runtime_error("the profile does not cover " + std::to_string(sets) +
+                                     " sets of " + std::to_string(ways) + " ways");
+        }
+        auto const& distances = m_levels[__builtin_ctzll(sets)].distances;
+        for (uint64_t d = 0; d != ways; ++d) hits += distances[d];
+        return m_accesses - hits;
+    }
+
+    bool supported(uint64_t size, uint64_t ways) const {
+        if (ways == 0) return true;
+        uint64_t sets = size / m_line_size / ways;
+        return ways <= m_max_ways and size % (m_line_size * ways) == 0 and sets != 0 and
+               (sets & (sets - 1)) == 0 and uint64_t(__builtin_ctzll(sets)) < m_levels.size();
+    }
+
+    /* The miss-ratio curves: one row per power-of-2 size, from 1 KiB to the size that holds
+       all the distinct lines, one column per power-of-2 number of ways. */
+    void print_curves(std::ostream& os = std::cout) const {
+        os << "miss-ratio curves (LRU), " << m_accesses << " accesses, " << m_cold
+           << " distinct lines:\n";
+        os << std::setw(12) << "size";
+        for (uint64_t ways = 1; ways <= m_max_ways; ways *= 2) {
+            os << std::setw(10) << std::to_string(ways) + "-way";
+        }
+        os << std::setw(12) << "fully-assoc" << "\n";
+        for (uint64_t size = 1024;; size *= 2) {
+            os << std::setw(8) << (size < (1 << 20) ? size >> 10 : size >> 20)
+               << (size < (1 << 20) ? " KiB" : " MiB");
+            for (uint64_t ways = 1; ways <= m_max_ways; ways *= 2) {
+                if (supported(size, ways)) {
+                    os << std::setw(10) << std::fixed << std::setprecision(4)
+                       << miss_ratio(size, ways);
+                } else {
+                    os << std::setw(10) << "-";
+                }
+            }
+            os << std::setw(12) << std::fixed << std::setprecision(4) << miss_ratio(size) << "\n";
+            if (size / m_line_size >= m_cold) break;
+        }
+        os << std::defaultfloat << std::flush;
+    }
+
+    double miss_ratio(uint64_t size, uint64_t ways = 0) const {
+        return m_accesses ? double(misses(size, ways)) / m_accesses : 0.0;
+    }
+
+    void clear() {
+        for (auto& level : m_levels) {
+            std::fill(level.tags.begin(), level.tags.end(), invalid_line);
+            std::fill(level.distances.begin(), level.distances.end(), 0);
+        }
+        m_last_access.clear();
+        m_distances.clear();
+        m_marks.clear();
+        m_accesses = 0;
+        m_cold = 0;
+    }
+
+private:
+    static constexpr uint64_t invalid_line = uint64_t(-1);
+
+    struct level {
+        std::vector<uint64_t> tags;  // the recency list of each set (most recent first)
+        // distances[d] := number of accesses at distance d in their set (max_ways: misses)
+        std::vector<uint64_t> distances;
+    };
+
+    uint64_t m_line_size;
+    uint64_t m_max_ways;
+    uint64_t m_accesses;
+    uint64_t m_cold;                       // number of first accesses to a line
+    std::vector<level> m_levels;           // m_levels[k]: 2^k sets
+    std::vector<uint64_t> m_distances;     // m_distances[d] := accesses at distance d
+    std::vector<uint32_t> m_marks;         // Fenwick tree of the last access times
+    std::unordered_map<uint64_t, uint64_t> m_last_access;  // line -> time
+
+    void access(uint64_t line) {
+        m_accesses += 1;
+        uint64_t time = m_accesses;
+        auto [it, first] = m_last_access.try_emplace(line, time);
+        if (first) {
+            m_cold += 1;
+        } else {
+            uint64_t d = marks(time - 1) - marks(it->second);
+            if (d >= m_distances.size()) m_distances.resize(d + 1, 0);
+            m_distances[d] += 1;
+            mark(it->second, -1);
+            it->second = time;
+        }
+        mark(time, +1);
+
+        for (uint64_t k = 0; k != m_levels.size(); ++k) {
+            uint64_t set = line & ((uint64_t(1) << k) - 1);
+            uint64_t* tags = m_levels[k].tags.data() + set * m_max_ways;
+            uint64_t i = 0;
+            while (i != m_max_ways and tags[i] != line) ++i;
+            m_levels[k].distances[i] += 1;
+            if (i == m_max_ways) i = m_max_ways - 1;
+            for (; i != 0; --i) tags[i] = tags[i - 1];
+            tags[0] = line;
+        }
+    }
+
+    // the number of marked times in [1, time]
+    uint64_t marks(uint64_t time) const {
+        uint64_t sum = 0;
+        for (; time != 0; time &= time - 1) sum += m_marks[time];
+        return sum;
+    }
+
+    void mark(uint64_t time, int delta) {
+        for (; time < m_marks.size(); time += time & -time) m_marks[time] += delta;
+    }
+};
@@ -4,85 +4,118 @@
 #include <chrono>
 #include <algorithm>
 #include <numeric>
-#include <unordered_set>
-
-constexpr uint64_t LINE_SIZE = 64;
-
-struct cache {
-    cache(uint64_t s, uint64_t w)
-        : size(s), ways(w), sets((size / LINE_SIZE) / ways), counters(sets) {
-        if (size % LINE_SIZE != 0) {
-            throw std::runtime_error("cache size must be divisible by the line size");
-        }
-    }
-
-    template <typename T>
-    void map(T const& x) {
-        uint64_t cache_line = reinterpret_cast<uint64_t>(&x) / LINE_SIZE;
-        uint64_t set = cache_line % sets;
-        auto it = counters[set].find(cache_line);
-        if (it == counters[set].end()) { counters[set].insert(cache_line); }
-    }
-
-    void print_usage() const {
-        std::cout << "cache specification:\n";
-        std::cout << "  size " << size << "\n";
-        std::cout << "  ways " << ways << "\n";
-        std::cout << "  sets " << sets << "\n";
-        std::cout << "cache usage:\n";
-        for (uint64_t i = 0; i != sets; ++i) { std::cout << counters[i].size() << " "; }
-        std::cout << std::endl;
-    }
-
-    void clear() {
-        for (auto& c : counters) c.clear();
-    }
-
-    uint64_t accesses() const {
-        uint64_t sum = 0;
-        for (auto const& c : counters) sum += c.size();
-        return sum;
-    }
-
-private:
-    uint64_t size;  // in bytes
-    uint64_t ways;
-    uint64_t sets;
-    std::vector<std::unordered_set<uint64_t>>
-        counters;  // counters[i] := the number of distinct cache lines
-                   // that would be stored in set i
-};
+#include <limits>
 
+#include "include/cache.hpp"
 #include "include/node64.hpp"
+#include "include/node.hpp"
 #include "include/segment_trees.hpp"
 #include "include/fenwick_trees.hpp"
+#include "include/cache_hierarchy.hpp"
+#include "include/trace.hpp"
 
-#define TEST                                                                               \
-    tree.build(input.data(), input.size());                                                \
-    int64_t sum = 0;                                                                       \
-    auto start = clock_t::now();                                                           \
-    for (auto q : queries) { sum += tree.sum(q, L1); }                                     \
-    auto stop = clock_t::now();                                                            \
-    auto elapsed = std::chrono::duration_cast<duration_t>(stop - start);                   \
-    std::cout << "# ignore " << sum << std::endl;                                          \
-    std::cout << "elapsed time: " << elapsed.count() / 1000 << " [millisec]" << std::endl; \
-    std::cout << "cache usage:\n";                                                         \
-    L1.print_usage();                                                                      \
-    std::cout << "accesses " << L1.accesses() << std::endl;                                \
-    std::cout << "iterations " << tree.iterations << std::endl;                            \
-    std::cout << "size " << tree.size() << std::endl;
+#define TEST                                                                                      \
+    tree.build(input.data(), input.size());                                                       \
+    int64_t sum = 0;                                                                              \
+    /* timing, without tracing: the best of timing_runs runs over timed_queries */                \
+    double best = std::numeric_limits<double>::max();                                             \
+    for (uint64_t run = 0; run != timing_runs; ++run) {                                           \
+        auto start = clock_t::now();                                                              \
+        for (auto q : timed_queries) { sum += tree.sum(q, untraced); }                            \
+        auto stop = clock_t::now();                                                               \
+        auto elapsed = std::chrono::duration_cast<duration_t>(stop - start);                      \
+        best = std::min<double>(best, elapsed.count());                                           \
+    }                                                                                             \
+    std::cout << "# ignore " << sum << std::endl;                                                 \
+    std::cout << "elapsed time: " << best / 1000000 << " [millisec] for " << timed_queries.size() \
+              << " queries, " << best / timed_queries.size() << " [nanosec/query]" << std::endl;  \
+    /* cache analysis, on the (fewer) queries */                                                  \
+    tree.iterations = 0;                                                                          \
+    for (auto q : queries) { sum += tree.sum(q, L1); }                                            \
+    std::cout << "cache usage:\n";                                                                \
+    L1.print_usage();                                                                             \
+    std::cout << "distinct lines " << L1.distinct_lines() << std::endl;                           \
+    std::cout << "accesses " << L1.accesses() << ", misses " << L1.misses() << std::endl;         \
+    std::cout << "iterations " << tree.iterations << std::endl;                                   \
+    std::cout << "size " << tree.size() << std::endl;                                             \
+    for (auto& hierarchy : hierarchies) {                                                         \
+        hierarchy.clear();                                                                        \
+        for (auto q : queries) { sum += tree.sum(q, hierarchy); }                                 \
+        hierarchy.print_stats();                                                                  \
+    }
 
 int main(int argc, char const** argv) {
     if (argc < 2) {
-        std::cout << "Usage: " << argv[0] << " <size>" << std::endl;
+        std::cout << "Usage: " << argv[0]
+                  << " <size> [--queries <timed queries>] [--trace <dir>]\n"
+                  << "       [--mix <updates:queries>[,<updates:queries>...]]\n"
+                  << "       " << argv[0] << " --replay <trace_file>" << std::endl;
         return 1;
     }
 
+    if (std::string(argv[1]) == "--replay") {
+        if (argc < 3) return 1;
+        trace_reader reader(argv[2]);
+        stack_distance_profile profile(reader.line_size());
+        profile.replay(reader);
+        profile.print_curves();
+        return 0;
+    }
+
+    /* the number of timed queries, the trace directory (no traces if empty)
+       and the update:query ratios of the mixed runs */
+    uint64_t num_timed_queries = 1000000;
+    std::string trace_dir;
+    std::vector<std::pair<uint64_t, uint64_t>> ratios = {{1, 9}, {1, 1}, {9, 1}};
+    for (int k = 2; k < argc; k += 2) {
+        std::string option = argv[k];
+        if (k + 1 == argc or
+            (option != "--queries" and option != "--trace" and option != "--mix")) {
+            std::cout << "unknown or incomplete option '" << option << "'" << std::endl;
+            return 1;
+        }
+        if (option == "--queries") {
+            num_timed_queries = std::stoull(argv[k + 1]);
+            if (!num_timed_queries) return 1;
+            continue;
+        }
+        if (option == "--trace") {
+            trace_dir = argv[k + 1];
+            continue;
+        }
+        ratios.clear();
+        std::string list = argv[k + 1];
+        for (uint64_t begin = 0; begin < list.size();) {
+            uint64_t end = std::min(list.find(',', begin), list.size());
+            std::string ratio = list.substr(begin, end - begin);
+            uint64_t colon = ratio.find(':');
+            if (colon == std::string::npos) {
+                std::cout << "invalid ratio '" << ratio << "'" << std::endl;
+                return 1;
+            }
+            ratios.emplace_back(std::stoull(ratio.substr(0, colon)),
+                                std::stoull(ratio.substr(colon + 1)));
+            if (ratios.back().first + ratios.back().second == 0) return 1;
+            begin = end + 1;
+        }
+    }
+
     constexpr unsigned seed = 192390;
     std::mt19937_64 rng(seed);
 
     cache L1(32 * 1024, 8);  // typical parameters for L1 cache
 
+    // typical parameters for L1, L2 and L3 caches, with the same replacement policy
+    auto levels = [](replacement policy) {
+        return std::vector<cache_config>{{32 * 1024, 8, LINE_SIZE, policy},
+                                         {1024 * 1024, 16, LINE_SIZE, policy},
+                                         {32 * 1024 * 1024, 16, LINE_SIZE, policy}};
+    };
+    std::vector<cache_hierarchy> hierarchies = {
+        cache_hierarchy(levels(replacement::lru)), cache_hierarchy(levels(replacement::plru)),
+        cache_hierarchy(levels(replacement::rrip)),
+        cache_hierarchy(levels(replacement::lru), inclusion::exclusive)};
+
     uint64_t n = std::stoull(argv[1]);
     if (!n) return 1;
     std::vector<int64_t> input(n, 1);
@@ -92,13 +125,121 @@ int main(int argc, char const** argv) {
     std::vector<uint64_t> queries(num_queries);
     std::generate(queries.begin(), queries.end(), [&] { return distr(rng); });
 
+    /* The timings are measured with the no-op tracer, on many more queries than those traced:
+       the simulation of the cache takes much longer than the queries themselves. */
+    no_tracer untraced;
+    constexpr uint64_t timing_runs = 3;
+    std::vector<uint64_t> timed_queries(num_timed_queries);
+    std::generate(timed_queries.begin(), timed_queries.end(), [&] { return distr(rng); });
+
     typedef std::chrono::high_resolution_clock clock_t;
-    typedef std::chrono::microseconds duration_t;
+    typedef std::chrono::nanoseconds duration_t;
+
+    // record the lines accessed by the queries in trace_dir/name.trace, and replay them
+    auto trace = [&](auto& tree, std::string const& name) {
+        if (trace_dir.empty()) return;
+        std::string filename = trace_dir + "/" + name + ".trace";
+        trace_writer writer(filename);
+        for (auto q : queries) tree.sum(q, writer);
+        writer.close();
+        std::cout << "trace " << filename << ": " << writer.accesses() << " accesses in "
+                  << writer.bytes() << " bytes" << std::endl;
+        trace_reader reader(filename);
+        stack_distance_profile profile;
+        profile.replay(reader);
+        profile.print_curves();
+    };
+
+    /* num_timed_queries operations (the first num_queries also traced), each an update
+       with probability updates / (updates + queries) */
+    auto mix = [&](auto& tree) {
+        for (auto [updates, queries] : ratios) {
+            std::bernoulli_distribution is_update(double(updates) / (updates + queries));
+            std::vector<std::pair<bool, uint64_t>> operations(num_timed_queries);
+            for (auto& op : operations) op = {is_update(rng), distr(rng)};
+            int64_t sum = 0;
+            auto run = [&](auto& c, uint64_t n) {
+                for (uint64_t k = 0; k != std::min<uint64_t>(n, operations.size()); ++k) {
+                    auto [update, i] = operations[k];
+                    if (update) {
+                        tree.update(i, 1, c);
+                    } else {
+                        sum += tree.sum(i, c);
+                    }
+                }
+            };
+            auto start = clock_t::now();
+            auto stop = start;
+            cache c(32 * 1024, 8);
+            try {
+                run(untraced, operations.size());
+                stop = clock_t::now();
+                run(c, num_queries);
+            } catch (std::runtime_error const& e) {  // the keys of node<fanout, key> overflow
+                std::cout << "updates:queries " << updates << ":" << queries << " - "
+                          << e.what() << std::endl;
+                return;
+            }
+            double elapsed = std::chrono::duration_cast<duration_t>(stop - start).count();
+            std::cout << "# ignore " << sum << "\n";
+            std::cout << "updates:queries " << updates << ":" << queries << " - "
+                      << elapsed / operations.size() << " [nanosec/op], accesses " << c.accesses()
+                      << ", misses " << c.misses() << std::endl;
+        }
+    };
+
+    /* The timed queries answered in batches of 1 to max_batch queries, with the batched sum
+       of the tree and with sum_sorted, against the loop of single queries. */
+    constexpr uint64_t max_batch = 256;
+    auto batch = [&](auto& tree) {
+        std::vector<int64_t> out(max_batch);
+        std::vector<uint64_t> scratch(3 * max_batch);  // of sum_sorted
+        int64_t sum = 0;
+        auto time = [&](auto const& run) {
+            double best = std::numeric_limits<double>::max();
+            for (uint64_t r = 0; r != timing_runs; ++r) {
+                auto start = clock_t::now();
+                run();
+                auto stop = clock_t::now();
+                best = std::min<double>(
+                    best, std::chrono::duration_cast<duration_t>(stop - start).count());
+            }
+            return best / timed_queries.size();
+        };
+        double single = time([&] {
+            for (auto q : timed_queries) sum += tree.sum(q, untraced);
+        });
+        std::cout << "single queries - " << single << " [nanosec/query]" << std::endl;
+        for (uint64_t size = 1; size <= max_batch; size *= 2) {
+            auto batched = [&](auto const& query) {
+                return time([&] {
+                    for (uint64_t k = 0; k < timed_queries.size(); k += size) {
+                        uint64_t m = std::min<uint64_t>(size, timed_queries.size() - k);
+                        query(timed_queries.data() + k, m, out.data());
+                        sum += out[m - 1];
+                    }
+                });
+            };
+            double unsorted = batched([&](uint64_t const* indices, uint64_t m, int64_t* sums) {
+                tree.sum(indices, m, sums, untraced);
+            });
+            double sorted = batched([&](uint64_t const* indices, uint64_t m, int64_t* sums) {
+                sum_sorted(tree, indices, m, sums, untraced, scratch);
+            });
+            std::cout << "batch " << size << " - " << unsorted << " [nanosec/query] (x"
+                      << single / unsorted << "), sorted " << sorted << " [nanosec/query] (x"
+                      << single / sorted << ")" << std::endl;
+        }
+        std::cout << "# ignore " << sum << std::endl;
+    };
 
     {
         std::cout << "=== fenwick_tree\n";
         fenwick_tree tree;
         TEST
+        trace(tree, "fenwick_tree");
+        mix(tree);
+        batch(tree);
     }
 
     L1.clear();
@@ -107,6 +248,9 @@ int main(int argc, char const** argv) {
         std::cout << "=== fenwick_tree_holes\n";
         fenwick_tree_holes tree;
         TEST
+        trace(tree, "fenwick_tree_holes");
+        mix(tree);
+        batch(tree);
     }
 
     L1.clear();
@@ -115,6 +259,9 @@ int main(int argc, char const** argv) {
         std::cout << "=== segment_tree_topdown\n";
         segment_tree_topdown tree;
         TEST
+        trace(tree, "segment_tree_topdown");
+        mix(tree);
+        batch(tree);
     }
 
     L1.clear();
@@ -123,6 +270,42 @@ int main(int argc, char const** argv) {
         std::cout << "=== segment_tree_bottomup\n";
         segment_tree_bottomup tree;
         TEST
+        trace(tree, "segment_tree_bottomup");
+        mix(tree);
+        batch(tree);
+    }
+
+    L1.clear();
+
+    {
+        std::cout << "=== segment_tree_eytzinger\n";
+        segment_tree_eytzinger tree;
+        TEST
+        trace(tree, "segment_tree_eytzinger");
+        mix(tree);
+        batch(tree);
+    }
+
+    L1.clear();
+
+    {
+        std::cout << "=== segment_tree_veb\n";
+        segment_tree_veb tree;
+        TEST
+        trace(tree, "segment_tree_veb");
+        mix(tree);
+        batch(tree);
+    }
+
+    L1.clear();
+
+    {
+        std::cout << "=== segment_tree_bary\n";
+        segment_tree_bary tree;
+        TEST
+        trace(tree, "segment_tree_bary");
+        mix(tree);
+        batch(tree);
     }
 
     L1.clear();
@@ -131,6 +314,91 @@ int main(int argc, char const** argv) {
         std::cout << "=== fenwick_tree_blocked<node64>\n";
         fenwick_tree_blocked<node64> tree;
         TEST
+        trace(tree, "fenwick_tree_blocked_node64");
+        mix(tree);
+        batch(tree);
+    }
+
+    // the nodes of node.hpp, for each fanout and key width
+    std::cout << "(updates of node<fanout, key> with " << simd::name(simd::current())
+              << " kernels)" << std::endl;
+    auto test_blocked = [&](auto const& node_tag) {
+        typedef std::decay_t<decltype(node_tag)> node_type;
+        std::string fanout = std::to_string(node_type::fanout);
+        std::string bits = std::to_string(8 * sizeof(typename node_type::key_type));
+        std::cout << "=== fenwick_tree_blocked<node<" << fanout << ", int" << bits << "_t>>\n";
+        L1.clear();
+        fenwick_tree_blocked<node_type> tree;
+        TEST
+        std::cout << "bytes per value " << double(tree.size() * sizeof(int64_t)) / n << std::endl;
+        trace(tree, "fenwick_tree_blocked_node_" + fanout + "_" + bits);
+        mix(tree);
+        batch(tree);
+
+        // +1 updates hammering the second value of a node: they must throw, and not wrap,
+        // as soon as the last key of its segment overflows
+        static constexpr uint64_t hammer_updates = 100000;
+        static constexpr uint64_t segment_size = node_type::segment_size;
+        fenwick_tree_blocked<node_type> hammered;
+        std::vector<int64_t> ones(node_type::fanout, 1);
+        hammered.build(ones.data(), ones.size());
+        uint64_t updates = 0;
+        try {
+            for (; updates != hammer_updates; ++updates) hammered.update(1, 1, untraced);
+        } catch (std::runtime_error const&) {
+        }
+        uint64_t max_updates = std::min<uint64_t>(
+            hammer_updates,
+            uint64_t(std::numeric_limits<typename node_type::key_type>::max()) - segment_size + 1);
+        if (updates != max_updates or
+            hammered.sum(segment_size - 1, untraced) != int64_t(segment_size + updates)) {
+            throw std::runtime_error("updates of node<" + fanout + ", int" + bits +
+                                     "_t> overflowed after " + std::to_string(updates));
+        }
+        std::cout << "one segment takes " << updates << " of " << hammer_updates
+                  << " updates without overflowing" << std::endl;
+    };
+    test_blocked(node<64, int16_t>());
+    test_blocked(node<64, int32_t>());
+    test_blocked(node<64, int64_t>());
+    test_blocked(node<256, int16_t>());
+    test_blocked(node<256, int32_t>());
+    test_blocked(node<256, int64_t>());
+    test_blocked(node<1024, int16_t>());
+    test_blocked(node<1024, int32_t>());
+    test_blocked(node<1024, int64_t>());
+
+    {
+        // simulation throughput, on the lines accessed by (many more) Fenwick-Tree queries
+        std::cout << "=== simulation throughput\n";
+        std::vector<uint64_t> lines;
+        while (lines.size() < (uint64_t(1) << 24)) {
+            for (uint64_t i = distr(rng) + 1; i != 0; i &= i - 1) {
+                lines.push_back(i * sizeof(int64_t) / LINE_SIZE);
+            }
+        }
+        constexpr uint64_t passes = 4;
+        uint64_t hardware_threads = std::max<uint64_t>(1, std::thread::hardware_concurrency());
+        simd::isa active = simd::current();
+        for (simd::isa level : simd::all_isas) {
+            if (!simd::supported(level)) continue;
+            simd::use(level);
+            for (uint64_t threads : {uint64_t(1), hardware_threads}) {
+                cache c(32 * 1024, 8, threads);
+                auto start = clock_t::now();
+                for (uint64_t p = 0; p != passes; ++p) {
+                    for (auto line : lines) c.access(line);
+                }
+                c.flush();
+                auto stop = clock_t::now();
+                double elapsed = std::chrono::duration_cast<duration_t>(stop - start).count();
+                std::cout << simd::name(level) << " kernels, " << threads
+                          << " thread(s): " << c.accesses() * 1000 / elapsed
+                          << " M accesses/sec; misses " << c.misses() << std::endl;
+                if (hardware_threads == 1) break;
+            }
+        }
+        simd::use(active);
     }
 
     return 0;
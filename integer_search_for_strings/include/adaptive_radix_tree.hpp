@@ -0,0 +1,344 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cassert>
+
+#include "util.hpp"
+#include "string_pool.hpp"
+
+/* An Adaptive Radix Tree (ART) [Leis et al., ICDE 2013] over a sorted collection of
+   distinct strings, mapping each string to its rank (i.e., the same ID assigned by string_pool).
+
+   - Inner nodes are of 4 types (node4, node16, node48, node256), depending on their
+     number of children, and store their compressed path (pessimistic path compression).
+   - A subtree holding a single string is collapsed into a leaf (lazy expansion),
+     whose string is kept in a string_pool and compared at the end of the search.
+   - Every node stores the range of IDs [begin, end) of its subtree: this makes lower_bound
+     terminate as soon as the query diverges from the tree.
+
+   All nodes are stored contiguously, in pre-order, and referenced with 32-bit integers:
+   a leaf is referenced as (id << 1) | 1, an inner node as its offset in 8-byte words << 1. */
+
+struct adaptive_radix_tree {
+    typedef uint32_t ref_type;
+
+    enum node_type : uint8_t { node4 = 0, node16 = 1, node48 = 2, node256 = 3 };
+
+    struct node_header {
+        node_type type;
+        uint8_t has_value;  // true if the path to this node is a string (whose ID is begin)
+        uint16_t num_children;
+        uint32_t prefix_length;
+        uint32_t begin;
+        uint32_t end;
+    };
+    static_assert(sizeof(node_header) == 16);
+
+    struct builder {
+        builder() {}
+
+        template <typename Iterator>
+        void build(Iterator begin, uint64_t n) {
+            if (n >= (uint64_t(1) << (sizeof(ref_type) * 8 - 1))) {
+                throw std::runtime_error("too many strings for " +
+                                         std::to_string(sizeof(ref_type) * 8) + "-bit references");
+            }
+            string_pool::builder pool_builder(n);
+            pool_builder.build(begin, n);
+            pool_builder.build(m_pool);
+
+            m_nodes.assign(8, 0);  // offset 0 is reserved to mean "no child"
+            m_root = n ? build(0, n, 0) : 0;
+
+            std::cout << "num. inner nodes: " << m_num_nodes[node4] + m_num_nodes[node16] +
+                                                     m_num_nodes[node48] + m_num_nodes[node256]
+                      << " (node4 " << m_num_nodes[node4] << ", node16 " << m_num_nodes[node16]
+                      << ", node48 " << m_num_nodes[node48] << ", node256 "
+                      << m_num_nodes[node256] << ")" << std::endl;
+        }
+
+        void build(adaptive_radix_tree& tree) {
+            tree.m_root = m_root;
+            std::swap(tree.m_pool, m_pool);
+            tree.m_nodes.swap(m_nodes);
+            builder().swap(*this);
+        }
+
+        void swap(builder& other) {
+            std::swap(other.m_root, m_root);
+            std::swap(other.m_num_nodes, m_num_nodes);
+            std::swap(other.m_pool, m_pool);
+            other.m_nodes.swap(m_nodes);
+        }
+
+    private:
+        ref_type m_root = 0;
+        uint64_t m_num_nodes[4] = {0, 0, 0, 0};
+        string_pool m_pool;
+        std::vector<uint8_t> m_nodes;
+
+        // build the subtree of the strings [lo, hi), sharing a prefix of length depth
+        ref_type build(uint64_t lo, uint64_t hi, uint64_t depth) {
+            assert(hi > lo);
+            if (hi - lo == 1) return (lo << 1) | 1;
+
+            byte_range first = m_pool.access(lo);
+            byte_range last = m_pool.access(hi - 1);
+            uint64_t first_size = first.end - first.begin;
+            uint64_t last_size = last.end - last.begin;
+            uint64_t lcp = depth + simd::lcp(first.begin + depth, last.begin + depth,
+                                             std::min(first_size, last_size) - depth);
+
+            node_header header;
+            header.has_value = first_size == lcp;
+            header.prefix_length = lcp - depth;
+            header.begin = lo;
+            header.end = hi;
+            if (header.has_value) ++lo;
+
+            // partition the remaining strings by their byte at position lcp
+            std::vector<std::pair<uint8_t, uint64_t>> children;  // (byte, first string)
+            for (uint64_t i = lo; i != hi;) {
+                assert(m_pool.access(i).end - m_pool.access(i).begin > int64_t(lcp));
+                uint8_t c = m_pool.access(i).begin[lcp];
+                children.emplace_back(c, i);
+                ++i;
+                while (i != hi and m_pool.access(i).begin[lcp] == c) ++i;
+            }
+            children.emplace_back(0, hi);  // sentinel
+            uint64_t num_children = children.size() - 1;
+            header.num_children = num_children;
+            header.type = num_children <= 4    ? node4
+                          : num_children <= 16 ? node16
+                          : num_children <= 48 ? node48
+                                               : node256;
+            m_num_nodes[header.type] += 1;
+
+            uint64_t offset = m_nodes.size();
+            uint64_t bytes = prefix_offset(header.type) + header.prefix_length;
+            m_nodes.resize(offset + (bytes + 7) / 8 * 8, 0);
+            memcpy(m_nodes.data() + offset, &header, sizeof(node_header));
+            memcpy(m_nodes.data() + offset + prefix_offset(header.type), first.begin + depth,
+                   header.prefix_length);
+
+            for (uint64_t i = 0; i != num_children; ++i) {
+                ref_type child = build(children[i].second, children[i + 1].second, lcp + 1);
+                uint8_t c = children[i].first;
+                uint8_t* node = m_nodes.data() + offset;  // NOTE: m_nodes may have grown
+                switch (header.type) {
+                    case node4:
+                    case node16: {
+                        uint64_t keys = sizeof(node_header);
+                        uint64_t refs = keys + (header.type == node4 ? 4 : 16);
+                        node[keys + i] = c;
+                        memcpy(node + refs + i * sizeof(ref_type), &child, sizeof(ref_type));
+                        break;
+                    }
+                    case node48: {
+                        uint64_t refs = sizeof(node_header) + 256;
+                        node[sizeof(node_header) + c] = i + 1;
+                        memcpy(node + refs + i * sizeof(ref_type), &child, sizeof(ref_type));
+                        break;
+                    }
+                    case node256: {
+                        memcpy(node + sizeof(node_header) + c * sizeof(ref_type), &child,
+                               sizeof(ref_type));
+                        break;
+                    }
+                }
+            }
+
+            uint64_t ref = (offset / 8) << 1;
+            if (ref >= (uint64_t(1) << (sizeof(ref_type) * 8))) {
+                throw std::runtime_error("tree too large for " +
+                                         std::to_string(sizeof(ref_type) * 8) +
+                                         "-bit references");
+            }
+            return ref;
+        }
+    };
+
+    adaptive_radix_tree() : m_root(0) {}
+
+    uint64_t size() const {
+        return m_pool.size();
+    }
+
+    byte_range access(uint64_t id) const {
+        return m_pool.access(id);
+    }
+
+    uint64_t lookup(byte_range string) const {
+        if (size() == 0) return constants::invalid_id;
+        uint64_t size = string.end - string.begin;
+        uint64_t depth = 0;
+        ref_type ref = m_root;
+        while (true) {
+            if (is_leaf(ref)) {
+                uint64_t id = ref >> 1;
+                return byte_range_compare(m_pool.access(id), string) == 0 ? id
+                                                                          : constants::invalid_id;
+            }
+            uint8_t const* node = node_at(ref);
+            node_header const& h = header(node);
+            if (size - depth < h.prefix_length or
+                simd::lcp(prefix(node), string.begin + depth, h.prefix_length) !=
+                    h.prefix_length) {
+                return constants::invalid_id;
+            }
+            depth += h.prefix_length;
+            if (depth == size) return h.has_value ? h.begin : constants::invalid_id;
+            ref = find_child(node, string.begin[depth]);
+            if (ref == 0) return constants::invalid_id;
+            depth += 1;
+        }
+    }
+
+    uint64_t lower_bound(byte_range string) const {
+        if (size() == 0) return 0;
+        uint64_t size = string.end - string.begin;
+        uint64_t depth = 0;
+        ref_type ref = m_root;
+        while (true) {
+            if (is_leaf(ref)) {
+                uint64_t id = ref >> 1;
+                return byte_range_compare(string, m_pool.access(id)) <= 0 ? id : id + 1;
+            }
+            uint8_t const* node = node_at(ref);
+            node_header const& h = header(node);
+            uint8_t const* p = prefix(node);
+            uint64_t m = std::min<uint64_t>(h.prefix_length, size - depth);
+            uint64_t l = simd::lcp(p, string.begin + depth, m);
+            if (l != m) return string.begin[depth + l] < p[l] ? h.begin : h.end;
+            if (l != h.prefix_length) return h.begin;  // string is a prefix of the path
+            depth += h.prefix_length;
+            if (depth == size) return h.begin;
+            uint8_t c = string.begin[depth];
+            ref_type child = find_child(node, c);
+            if (child == 0) {
+                child = find_greater_child(node, c);
+                return child == 0 ? h.end : begin_of(child);
+            }
+            ref = child;
+            depth += 1;
+        }
+    }
+
+    uint64_t lower_bound(std::string const& string) const {
+        return lower_bound(byte_range_from_string(string));
+    }
+
+    // bytes taken by the inner nodes
+    uint64_t tree_bytes() const {
+        return m_nodes.size() * sizeof(m_nodes.front());
+    }
+
+    uint64_t bytes() const {
+        return tree_bytes() + m_pool.bytes();
+    }
+
+private:
+    ref_type m_root;
+    string_pool m_pool;
+    std::vector<uint8_t> m_nodes;
+
+    static uint64_t prefix_offset(node_type type) {
+        switch (type) {
+            case node4:
+                return sizeof(node_header) + 4 + 4 * sizeof(ref_type);
+            case node16:
+                return sizeof(node_header) + 16 + 16 * sizeof(ref_type);
+            case node48:
+                return sizeof(node_header) + 256 + 48 * sizeof(ref_type);
+            default:
+                return sizeof(node_header) + 256 * sizeof(ref_type);
+        }
+    }
+
+    static bool is_leaf(ref_type ref) {
+        return ref & 1;
+    }
+
+    uint8_t const* node_at(ref_type ref) const {
+        return m_nodes.data() + (uint64_t(ref >> 1) << 3);
+    }
+
+    static node_header const& header(uint8_t const* node) {
+        return *reinterpret_cast<node_header const*>(node);
+    }
+
+    static uint8_t const* prefix(uint8_t const* node) {
+        return node + prefix_offset(header(node).type);
+    }
+
+    static ref_type const* refs(uint8_t const* node) {
+        uint64_t offset = sizeof(node_header);
+        switch (header(node).type) {
+            case node4:
+                offset += 4;
+                break;
+            case node16:
+                offset += 16;
+                break;
+            case node48:
+                offset += 256;
+                break;
+            default:
+                break;
+        }
+        return reinterpret_cast<ref_type const*>(node + offset);
+    }
+
+    uint64_t begin_of(ref_type ref) const {
+        return is_leaf(ref) ? (ref >> 1) : header(node_at(ref)).begin;
+    }
+
+    static ref_type find_child(uint8_t const* node, uint8_t c) {
+        node_header const& h = header(node);
+        uint8_t const* keys = node + sizeof(node_header);
+        switch (h.type) {
+            case node4:
+                for (uint64_t i = 0; i != h.num_children; ++i) {
+                    if (keys[i] == c) return refs(node)[i];
+                }
+                return 0;
+            case node16: {
+                __m128i k = _mm_loadu_si128(reinterpret_cast<__m128i const*>(keys));
+                uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(k, _mm_set1_epi8(c))) &
+                                ((uint32_t(1) << h.num_children) - 1);
+                return mask ? refs(node)[__builtin_ctz(mask)] : 0;
+            }
+            case node48: {
+                uint8_t slot = keys[c];
+                return slot ? refs(node)[slot - 1] : 0;
+            }
+            default:
+                return refs(node)[c];
+        }
+    }
+
+    // the first child whose byte is greater than c (0 if none)
+    static ref_type find_greater_child(uint8_t const* node, uint8_t c) {
+        node_header const& h = header(node);
+        uint8_t const* keys = node + sizeof(node_header);
+        switch (h.type) {
+            case node4:
+            case node16:
+                for (uint64_t i = 0; i != h.num_children; ++i) {
+                    if (keys[i] > c) return refs(node)[i];
+                }
+                return 0;
+            case node48:
+                for (uint64_t i = uint64_t(c) + 1; i < 256; ++i) {
+                    if (keys[i]) return refs(node)[keys[i] - 1];
+                }
+                return 0;
+            default:
+                for (uint64_t i = uint64_t(c) + 1; i < 256; ++i) {
+                    if (refs(node)[i]) return refs(node)[i];
+                }
+                return 0;
+        }
+    }
+};
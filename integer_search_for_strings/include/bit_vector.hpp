@@ -0,0 +1,202 @@
+#pragma once
+
+#include <vector>
+#include <cassert>
+#include <cstdint>
+
+/* A bit vector supporting rank1 and select0 queries.
+
+   - rank1 uses the number of ones before each block of 512 bits (one 64-bit integer
+     per block, i.e., 12.5% of extra space) and popcounts the words of the block.
+   - select0 samples the block holding every 512-th zero and scans the blocks from there. */
+
+struct bit_vector {
+    static const uint64_t block_bits = 512;
+    static const uint64_t words_per_block = block_bits / 64;
+
+    struct builder {
+        builder() : m_size(0) {}
+
+        void push_back(bool bit) {
+            if (m_size % 64 == 0) m_bits.push_back(0);
+            if (bit) m_bits.back() |= uint64_t(1) << (m_size % 64);
+            ++m_size;
+        }
+
+        void build(bit_vector& bv) {
+            bv.m_size = m_size;
+            bv.m_bits.swap(m_bits);
+            bv.build_index();
+            builder().swap(*this);
+        }
+
+        void swap(builder& other) {
+            std::swap(other.m_size, m_size);
+            other.m_bits.swap(m_bits);
+        }
+
+    private:
+        uint64_t m_size;
+        std::vector<uint64_t> m_bits;
+    };
+
+    bit_vector() : m_size(0) {}
+
+    uint64_t size() const {
+        return m_size;
+    }
+
+    bool operator[](uint64_t i) const {
+        assert(i < size());
+        return (m_bits[i / 64] >> (i % 64)) & 1;
+    }
+
+    // number of ones in [0, i)
+    uint64_t rank1(uint64_t i) const {
+        assert(i <= size());
+        uint64_t block = i / block_bits;
+        uint64_t r = m_block_ranks[block];
+        for (uint64_t w = block * words_per_block; w != i / 64; ++w) {
+            r += __builtin_popcountll(m_bits[w]);
+        }
+        if (i % 64) r += __builtin_popcountll(m_bits[i / 64] << (64 - i % 64));
+        return r;
+    }
+
+    // position of the k-th zero (k = 0, 1, ...)
+    uint64_t select0(uint64_t k) const {
+        assert(k < m_size - m_block_ranks.back());
+        uint64_t block = m_select0_samples[k / block_bits];
+        uint64_t blocks = m_block_ranks.size() - 1;
+        while (block + 1 < blocks and zeros_before(block + 1) <= k) ++block;
+        k -= zeros_before(block);
+        uint64_t w = block * words_per_block;
+        for (;; ++w) {
+            uint64_t zeros = __builtin_popcountll(~m_bits[w]);
+            if (k < zeros) break;
+            k -= zeros;
+        }
+        uint64_t x = ~m_bits[w];
+        for (; k; --k) x &= x - 1;  // clear the lowest k zeros
+        return w * 64 + __builtin_ctzll(x);
+    }
+
+    // position of the first zero at or after position i (there must be one)
+    uint64_t next0(uint64_t i) const {
+        assert(i < size());
+        uint64_t w = i / 64;
+        uint64_t x = ~m_bits[w] & (uint64_t(-1) << (i % 64));
+        while (!x) x = ~m_bits[++w];
+        return w * 64 + __builtin_ctzll(x);
+    }
+
+    uint64_t bytes() const {
+        return m_bits.size() * sizeof(m_bits.front()) +
+               m_block_ranks.size() * sizeof(m_block_ranks.front()) +
+               m_select0_samples.size() * sizeof(m_select0_samples.front());
+    }
+
+private:
+    uint64_t m_size;
+    std::vector<uint64_t> m_bits;
+    std::vector<uint64_t> m_block_ranks;       // ones before each block (plus the total)
+    std::vector<uint32_t> m_select0_samples;  // block of the zeros 0, 512, 1024, ...
+
+    uint64_t zeros_before(uint64_t block) const {
+        return block * block_bits - m_block_ranks[block];
+    }
+
+    void build_index() {
+        // NOTE: the bits past the end of the last word are set,
+        // so that they are not counted as zeros
+        if (m_size % 64) m_bits.back() |= uint64_t(-1) << (m_size % 64);
+        uint64_t blocks = (m_bits.size() + words_per_block - 1) / words_per_block;
+        m_bits.resize(blocks * words_per_block, uint64_t(-1));
+        m_block_ranks.clear();
+        m_select0_samples.clear();
+        uint64_t ones = 0, zeros = 0;
+        for (uint64_t b = 0; b != blocks; ++b) {
+            m_block_ranks.push_back(ones);
+            for (uint64_t w = b * words_per_block; w != (b + 1) * words_per_block; ++w) {
+                uint64_t block_zeros = __builtin_popcountll(~m_bits[w]);
+                // samples for the zeros in [zeros, zeros + block_zeros)
+                while (m_select0_samples.size() * block_bits < zeros + block_zeros) {
+                    m_select0_samples.push_back(b);
+                }
+                zeros += block_zeros;
+                ones += __builtin_popcountll(m_bits[w]);
+            }
+        }
+        // the ones in the padding are not counted
+        m_block_ranks.push_back(m_size - zeros);
+    }
+};
+
+/* A vector of integers of (at most) width bits each, packed into 64-bit words. */
+
+struct compact_vector {
+    struct builder {
+        builder(uint64_t n = 0, uint64_t width = 1) : m_size(n), m_width(width) {
+            assert(width > 0 and width <= 64);
+            m_bits.resize((n * width + 63) / 64 + 1, 0);  // one word of padding
+        }
+
+        void set(uint64_t i, uint64_t x) {
+            assert(i < m_size);
+            assert(m_width == 64 or x < (uint64_t(1) << m_width));
+            uint64_t pos = i * m_width;
+            uint64_t w = pos / 64, shift = pos % 64;
+            m_bits[w] |= x << shift;
+            if (shift + m_width > 64) m_bits[w + 1] |= x >> (64 - shift);
+        }
+
+        void build(compact_vector& cv) {
+            cv.m_size = m_size;
+            cv.m_width = m_width;
+            cv.m_mask = m_width == 64 ? uint64_t(-1) : (uint64_t(1) << m_width) - 1;
+            cv.m_bits.swap(m_bits);
+            builder().swap(*this);
+        }
+
+        void swap(builder& other) {
+            std::swap(other.m_size, m_size);
+            std::swap(other.m_width, m_width);
+            other.m_bits.swap(m_bits);
+        }
+
+    private:
+        uint64_t m_size;
+        uint64_t m_width;
+        std::vector<uint64_t> m_bits;
+    };
+
+    compact_vector() : m_size(0), m_width(0), m_mask(0) {}
+
+    // the number of bits needed to represent x (at least 1)
+    static uint64_t width(uint64_t x) {
+        return x ? 64 - __builtin_clzll(x) : 1;
+    }
+
+    uint64_t size() const {
+        return m_size;
+    }
+
+    uint64_t operator[](uint64_t i) const {
+        assert(i < size());
+        uint64_t pos = i * m_width;
+        uint64_t w = pos / 64, shift = pos % 64;
+        uint64_t x = m_bits[w] >> shift;
+        if (shift + m_width > 64) x |= m_bits[w + 1] << (64 - shift);
+        return x & m_mask;
+    }
+
+    uint64_t bytes() const {
+        return m_bits.size() * sizeof(m_bits.front());
+    }
+
+private:
+    uint64_t m_size;
+    uint64_t m_width;
+    uint64_t m_mask;
+    std::vector<uint64_t> m_bits;
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <cassert>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* A fixed number of page-sized frames caching the pages of a read-only file.
+   Missing pages are read with pread and the frame to evict is chosen with the
+   CLOCK policy: the hand sweeps the frames, clearing their reference bit, and stops
+   at the first frame whose bit is already clear.
+
+   Frames are page-aligned, so that the file can also be opened with O_DIRECT
+   (bypassing the page cache of the OS, which otherwise serves most of the reads). */
+
+struct buffer_pool {
+    static constexpr uint32_t invalid = uint32_t(-1);
+
+    buffer_pool()
+        : m_fd(-1), m_page_size(0), m_hand(0), m_reads(0), m_fetches(0), m_frames(nullptr) {}
+
+    buffer_pool(buffer_pool const&) = delete;
+    buffer_pool& operator=(buffer_pool const&) = delete;
+
+    ~buffer_pool() {
+        close();
+    }
+
+    void open(std::string const& filename, uint64_t page_size, uint64_t num_pages,
+              uint64_t num_frames, bool direct_io = false) {
+        close();
+        assert(page_size > 0 and num_frames > 0);
+        m_fd = ::open(filename.c_str(), O_RDONLY | (direct_io ? O_DIRECT : 0));
+        if (m_fd < 0) {
+            throw std::runtime_error("cannot open " + filename + ": " + std::strerror(errno));
+        }
+        m_page_size = page_size;
+        m_frames = static_cast<uint8_t*>(std::aligned_alloc(page_size, num_frames * page_size));
+        if (!m_frames) throw std::runtime_error("cannot allocate buffer pool frames");
+        m_frame_of.assign(num_pages, invalid);
+        m_page_of.assign(num_frames, invalid);
+        m_referenced.assign(num_frames, 0);
+        m_hand = 0;
+        reset_stats();
+    }
+
+    void close() {
+        if (m_fd >= 0) ::close(m_fd);
+        std::free(m_frames);
+        m_fd = -1;
+        m_frames = nullptr;
+        m_frame_of.clear();
+        m_page_of.clear();
+        m_referenced.clear();
+    }
+
+    bool is_open() const {
+        return m_fd >= 0;
+    }
+
+    // return the frame holding the given page, reading it from the file if necessary
+    uint8_t const* fetch(uint64_t page) {
+        assert(is_open() and page < m_frame_of.size());
+        ++m_fetches;
+        uint32_t f = m_frame_of[page];
+        if (f == invalid) {
+            f = victim();
+            if (m_page_of[f] != invalid) m_frame_of[m_page_of[f]] = invalid;
+            read(page, f);
+            m_page_of[f] = page;
+            m_frame_of[page] = f;
+        }
+        m_referenced[f] = 1;
+        return frame(f);
+    }
+
+    uint64_t page_size() const {
+        return m_page_size;
+    }
+
+    uint64_t num_frames() const {
+        return m_page_of.size();
+    }
+
+    // number of pages read from the file since the last reset
+    uint64_t reads() const {
+        return m_reads;
+    }
+
+    // number of pages requested since the last reset
+    uint64_t fetches() const {
+        return m_fetches;
+    }
+
+    void reset_stats() {
+        m_reads = 0;
+        m_fetches = 0;
+    }
+
+    uint64_t bytes() const {
+        return num_frames() * m_page_size + m_frame_of.size() * sizeof(m_frame_of.front()) +
+               m_page_of.size() * sizeof(m_page_of.front()) +
+               m_referenced.size() * sizeof(m_referenced.front());
+    }
+
+private:
+    int m_fd;
+    uint64_t m_page_size;
+    uint64_t m_hand;
+    uint64_t m_reads;
+    uint64_t m_fetches;
+    uint8_t* m_frames;
+    std::vector<uint32_t> m_frame_of;  // page -> frame
+    std::vector<uint32_t> m_page_of;   // frame -> page
+    std::vector<uint8_t> m_referenced;
+
+    uint8_t* frame(uint64_t f) const {
+        return m_frames + f * m_page_size;
+    }
+
+    uint32_t victim() {
+        while (m_referenced[m_hand]) {
+            m_referenced[m_hand] = 0;
+            m_hand = m_hand + 1 == num_frames() ? 0 : m_hand + 1;
+        }
+        uint32_t f = m_hand;
+        m_hand = m_hand + 1 == num_frames() ? 0 : m_hand + 1;
+        return f;
+    }
+
+    void read(uint64_t page, uint64_t f) {
+        ++m_reads;
+        uint8_t* out = frame(f);
+        uint64_t offset = page * m_page_size;
+        uint64_t count = 0;
+        while (count != m_page_size) {
+            ssize_t ret = ::pread(m_fd, out + count, m_page_size - count, offset + count);
+            if (ret < 0 and errno == EINTR) continue;
+            if (ret <= 0) {
+                throw std::runtime_error(std::string("cannot read page ") +
+                                         std::to_string(page) + ": " +
+                                         (ret ? std::strerror(errno) : "unexpected EOF"));
+            }
+            count += ret;
+        }
+    }
+};
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cassert>
+#include <cmath>
+
+#include "util.hpp"
+#include "front_coding.hpp"
+#include "tracing.hpp"
+#include "buffer_pool.hpp"
+
+/* A disk-resident front_coded_dictionary (with the plain entry format).
+   Only the headers and the offsets of the buckets are kept in memory:
+   the entries of the buckets are written to a file of page-aligned blocks and
+   read through a buffer_pool of bounded size.
+
+   A bucket is never split across two pages, unless it is larger than a page:
+   in that case it starts at a page boundary and spans the minimum number of pages. */
+
+template <uint64_t BucketSize>
+struct external_front_coded_dictionary {
+    struct builder {
+        builder(std::string const& filename, uint64_t page_size = 4096)
+            : m_filename(filename), m_page_size(page_size), m_size(0), m_max_string_length(0) {}
+
+        template <typename Iterator>
+        void build(Iterator begin, uint64_t n) {
+            m_size = n;
+            uint64_t buckets = std::ceil(static_cast<double>(n) / (BucketSize + 1));
+            uint64_t tail = n % (BucketSize + 1);
+            tail = tail ? tail - 1 : BucketSize;  // remove header
+
+            std::cout << "n " << n << std::endl;
+            std::cout << "buckets " << buckets << std::endl;
+
+            std::ofstream out(m_filename, std::ios::binary);
+            if (!out) throw std::runtime_error("cannot open " + m_filename);
+
+            m_headers_offsets.reserve(buckets + 1);
+            m_buckets_offsets.reserve(buckets + 1);
+            m_headers_offsets.push_back(0);
+
+            uint64_t offset = 0;  // in the file
+            std::vector<uint8_t> data;
+            std::string prev, curr, header;
+            for (uint64_t b = 0; b != buckets; ++b) {
+                header = *begin++;
+                m_max_string_length = std::max<uint64_t>(m_max_string_length, header.size());
+                m_headers.insert(m_headers.end(), header.begin(), header.end());
+                static const uint64_t max_addressable_size = uint64_t(1) << 32;
+                if (m_headers.size() >= max_addressable_size) {
+                    throw std::runtime_error(
+                        "Error: offsets to headers must be made 64-bit "
+                        "integers");
+                }
+                m_headers_offsets.push_back(m_headers.size());
+                prev.swap(header);
+                data.clear();
+                uint64_t size = b != buckets - 1 ? BucketSize : tail;
+                for (uint64_t i = 0; i != size; ++i) {
+                    curr = *begin++;
+                    uint64_t l = string_lcp(curr, prev);
+                    uint64_t size = curr.size();
+                    assert(size >= l);
+                    m_max_string_length = std::max(m_max_string_length, size);
+                    write_varint(data, l);
+                    write_varint(data, size - l);
+                    data.insert(data.end(), curr.begin() + l, curr.end());
+                    prev.swap(curr);
+                }
+                uint64_t free = m_page_size - offset % m_page_size;
+                if (data.size() > free and free != m_page_size) offset += pad(out, free);
+                m_buckets_offsets.push_back(offset);
+                out.write(reinterpret_cast<char const*>(data.data()), data.size());
+                offset += data.size();
+            }
+            m_buckets_offsets.push_back(offset);
+            if (offset % m_page_size) pad(out, m_page_size - offset % m_page_size);
+            out.close();
+
+            std::cout << "pages " << (offset + m_page_size - 1) / m_page_size << std::endl;
+            std::cout << "DONE" << std::endl;
+        }
+
+        void swap(builder& other) {
+            other.m_filename.swap(m_filename);
+            std::swap(other.m_page_size, m_page_size);
+            std::swap(other.m_size, m_size);
+            std::swap(other.m_max_string_length, m_max_string_length);
+            other.m_headers_offsets.swap(m_headers_offsets);
+            other.m_buckets_offsets.swap(m_buckets_offsets);
+            other.m_headers.swap(m_headers);
+        }
+
+        // the dictionary must then be opened, with a memory budget for its buffer pool
+        void build(external_front_coded_dictionary& dict) {
+            dict.m_pool.close();
+            dict.m_filename = m_filename;
+            dict.m_page_size = m_page_size;
+            dict.m_size = m_size;
+            dict.m_max_string_length = m_max_string_length;
+            dict.m_headers_offsets.swap(m_headers_offsets);
+            dict.m_buckets_offsets.swap(m_buckets_offsets);
+            dict.m_headers.swap(m_headers);
+            builder(m_filename, m_page_size).swap(*this);
+        }
+
+    private:
+        std::string m_filename;
+        uint64_t m_page_size;
+        uint64_t m_size;
+        uint64_t m_max_string_length;
+        std::vector<uint32_t> m_headers_offsets;
+        std::vector<uint64_t> m_buckets_offsets;  // in the file
+        std::vector<uint8_t> m_headers;
+
+        static uint64_t pad(std::ofstream& out, uint64_t bytes) {
+            static const char zeros[4096] = {0};
+            for (uint64_t i = 0; i < bytes; i += sizeof(zeros)) {
+                out.write(zeros, std::min<uint64_t>(bytes - i, sizeof(zeros)));
+            }
+            return bytes;
+        }
+    };
+
+    external_front_coded_dictionary() : m_page_size(0), m_size(0), m_max_string_length(0) {}
+
+    /* Open the file of the buckets with a buffer pool of (at least one page and)
+       at most memory_budget bytes. The pool never has more frames than the file has pages,
+       but keeps one frame when the file has none (no bucket has entries beyond its header,
+       e.g., for a single string). */
+    void open(uint64_t memory_budget, bool direct_io = false) {
+        uint64_t num_frames = std::min(memory_budget / m_page_size, pages());
+        m_pool.open(m_filename, m_page_size, pages(), std::max<uint64_t>(1, num_frames),
+                    direct_io);
+    }
+
+    uint64_t size() const {
+        return m_size;
+    }
+
+    uint64_t max_string_length() const {
+        return m_max_string_length;
+    }
+
+    uint64_t lookup(byte_range string) {
+        auto [header, string_is_header, bucket] = locate_bucket(string);
+        uint64_t base = bucket * (BucketSize + 1);
+        if (string_is_header) return base;
+        if (bucket == 0 and byte_range_compare(header, string) > 0) return constants::invalid_id;
+        bool found = false;
+        uint64_t i = search(string, header, bucket, &found);
+        return found ? base + i : constants::invalid_id;
+    }
+
+    uint64_t lower_bound(byte_range string) {
+        auto [header, string_is_header, bucket] = locate_bucket(string);
+        uint64_t base = bucket * (BucketSize + 1);
+        if (string_is_header) return base;
+        if (bucket == 0 and byte_range_compare(header, string) > 0) return 0;
+        return base + search(string, header, bucket, nullptr);
+    }
+
+    uint64_t access(uint64_t id, uint8_t* string) {
+        assert(id < size());
+        uint64_t bucket = id / (BucketSize + 1);
+        uint64_t offset = id % (BucketSize + 1);
+        byte_range header = access_header(bucket);
+        uint64_t size = header.end - header.begin;
+        memcpy(string, header.begin, size);
+        if (offset == 0) return size;
+        uint8_t const* curr = bucket_data(bucket);
+        for (uint64_t i = 1; i <= offset; ++i) {
+            uint64_t lcp_len = read_varint(curr);
+            uint64_t suffix_len = read_varint(curr);
+            memcpy(string + lcp_len, curr, suffix_len);
+            curr += suffix_len;
+            size = lcp_len + suffix_len;
+        }
+        return size;
+    }
+
+    std::string access(uint64_t id) {
+        std::string string;
+        string.resize(m_max_string_length);
+        uint64_t size = access(id, reinterpret_cast<uint8_t*>(string.data()));
+        string.resize(size);
+        return string;
+    }
+
+    buffer_pool const& pool() const {
+        return m_pool;
+    }
+
+    void reset_stats() {
+        m_pool.reset_stats();
+    }
+
+    // bytes of the file holding the buckets
+    uint64_t file_bytes() const {
+        return pages() * m_page_size;
+    }
+
+    // bytes kept in memory, buffer pool included
+    uint64_t bytes() const {
+        return m_headers_offsets.size() * sizeof(m_headers_offsets.front()) +
+               m_buckets_offsets.size() * sizeof(m_buckets_offsets.front()) +
+               m_headers.size() * sizeof(m_headers.front()) + m_pool.bytes();
+    }
+
+private:
+    std::string m_filename;
+    uint64_t m_page_size;
+    uint64_t m_size;
+    uint64_t m_max_string_length;
+    std::vector<uint32_t> m_headers_offsets;
+    std::vector<uint64_t> m_buckets_offsets;
+    std::vector<uint8_t> m_headers;
+    buffer_pool m_pool;
+    std::vector<uint8_t> m_scratch;  // for the buckets spanning several pages
+
+    uint64_t buckets() const {
+        assert(m_headers_offsets.size() > 0);
+        return m_headers_offsets.size() - 1;
+    }
+
+    uint64_t pages() const {
+        return (m_buckets_offsets.back() + m_page_size - 1) / m_page_size;
+    }
+
+    uint64_t bucket_size(uint64_t bucket) const {
+        if (bucket != buckets() - 1) return BucketSize;
+        uint64_t tail = size() % (BucketSize + 1);
+        return tail ? tail - 1 : BucketSize;
+    }
+
+    byte_range access_header(uint64_t id) const {
+        assert(id < buckets());
+        uint64_t begin = m_headers_offsets[id];
+        uint64_t end = m_headers_offsets[id + 1];
+        return {m_headers.data() + begin, m_headers.data() + end};
+    }
+
+    /* Return the entries of the bucket. The pointer is valid until the next fetch
+       from the buffer pool. NOTE: the padding following a bucket lies in its last page,
+       hence [m_buckets_offsets[b], m_buckets_offsets[b + 1]) spans the same pages. */
+    uint8_t const* bucket_data(uint64_t bucket) {
+        assert(m_pool.is_open());
+        uint64_t begin = m_buckets_offsets[bucket];
+        uint64_t end = m_buckets_offsets[bucket + 1];
+        assert(end > begin);
+        uint64_t first = begin / m_page_size;
+        uint64_t last = (end - 1) / m_page_size;
+        if (first == last) return m_pool.fetch(first) + begin % m_page_size;
+        assert(begin % m_page_size == 0);
+        m_scratch.resize((last - first + 1) * m_page_size);
+        for (uint64_t p = first; p <= last; ++p) {
+            memcpy(m_scratch.data() + (p - first) * m_page_size, m_pool.fetch(p), m_page_size);
+        }
+        return m_scratch.data();
+    }
+
+    std::tuple<byte_range, bool, int> locate_bucket(byte_range string) const {
+        int lo = 0, hi = buckets() - 1, mi = 0, cmp = 0;
+        byte_range header;
+        while (lo <= hi) {
+            mi = (lo + hi) / 2;
+            header = access_header(mi);
+            cmp = byte_range_compare(header, string);
+            if (cmp > 0) {
+                hi = mi - 1;
+            } else if (cmp < 0) {
+                lo = mi + 1;
+            } else {
+                return {header, true, mi};
+            }
+        }
+        int bucket = mi;
+        if (cmp > 0) {
+            bucket = hi == -1 ? 0 : hi;
+            header = access_header(bucket);
+        }
+        return {header, false, bucket};
+    }
+
+    // the scan of front_coding.hpp, on the bucket fetched from the buffer pool
+    uint64_t search(byte_range string, byte_range header, uint64_t bucket, bool* found) {
+        uint64_t n = bucket_size(bucket);
+        if (n == 0) return 1;
+        return front_coded_search(bucket_data(bucket), n, string, header, no_tracer(), found);
+    }
+};
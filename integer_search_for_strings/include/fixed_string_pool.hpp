@@ -5,6 +5,7 @@
 #include <cassert>
 
 #include "util.hpp"
+#include "radix_jump_table.hpp"
 
 /* A pool of strings where each string has a fixed size, specified by a template. */
 
@@ -34,12 +35,22 @@ struct fixed_string_pool {
         return {m_strings.data() + begin, m_strings.data() + begin + string_size};
     }
 
+    // optional: restrict the binary searches of lower_bound with a radix_jump_table
+    void build_jump_table() {
+        m_jump_table.build(size(), [&](uint64_t i) { return radix_jump_table::key(access(i)); });
+    }
+
     uint64_t lower_bound(std::string const& val) const {
         int64_t count = size();
         int64_t step = 0;
         uint64_t i = 0;
         uint64_t ret = 0;
         auto target = byte_range_from_string<string_size>(val);
+        if (!m_jump_table.empty()) {
+            auto [begin, end] = m_jump_table.range(radix_jump_table::key(target));
+            ret = begin;
+            count = end - begin;
+        }
         while (count > 0) {
             i = ret;
             step = count / 2;
@@ -62,7 +73,12 @@ struct fixed_string_pool {
         return ret;
     }
 
+    uint64_t bytes() const {
+        return m_strings.size() * sizeof(m_strings.front()) + m_jump_table.bytes();
+    }
+
 private:
     uint64_t m_num_strings;
     std::vector<uint8_t> m_strings;
+    radix_jump_table m_jump_table;
 };
\ No newline at end of file
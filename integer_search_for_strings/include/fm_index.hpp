@@ -0,0 +1,234 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cassert>
+#include <algorithm>
+#include <stdexcept>
+
+#include "util.hpp"
+#include "string_pool.hpp"
+#include "bit_vector.hpp"
+#include "wavelet_matrix.hpp"
+
+/* An FM-index [Ferragina and Manzini, FOCS 2000] over a sorted collection of distinct strings,
+   to find the IDs (as assigned by string_pool) of the strings containing a given substring.
+
+   - The text is $_0 s_0 $_1 s_1 ... $_{n-1} s_{n-1}, where the separators $_i are
+     distinct symbols smaller than any byte, ordered by i, and the text is considered
+     circular. Since the strings are sorted, the rotations starting with s_i $_{i+1} are
+     in the same order as the separators $_i, so that the LF mapping is correct even if
+     all the separators are represented by the byte 0 in the BWT (hence the strings
+     must not contain the byte 0). The first n rows of the sorted rotations are those
+     starting with $_0, ..., $_{n-1}: stepping backwards (with LF) from an occurrence
+     until a separator gives the ID of the string directly.
+   - The BWT is stored in a wavelet_matrix: count takes 2 ranks per byte of the pattern.
+   - To bound the number of LF steps of locate, the rows of the rotations starting at
+     the text positions that are multiple of sample_rate are marked in a bit_vector and
+     the IDs of their strings are stored in a compact_vector.
+   - The suffix array is built by prefix doubling (with radix sort) over the rotations,
+     taking 20 bytes per text byte at build time. */
+
+struct fm_index {
+    static constexpr uint64_t sample_rate = 32;
+    static constexpr uint8_t separator = 0;
+
+    struct builder {
+        builder() : m_size(0) {}
+
+        template <typename Iterator>
+        void build(Iterator begin, uint64_t n) {
+            string_pool::builder pool_builder(n);
+            pool_builder.build(begin, n);
+            string_pool pool;
+            pool_builder.build(pool);
+
+            // the text: separator + string, for each string
+            std::vector<uint8_t> text;
+            for (uint64_t i = 0; i != n; ++i) {
+                byte_range br = pool.access(i);
+                if (std::find(br.begin, br.end, separator) != br.end) {
+                    throw std::runtime_error("strings must not contain the byte 0");
+                }
+                text.push_back(separator);
+                text.insert(text.end(), br.begin, br.end);
+            }
+            pool = string_pool();
+            if (text.size() >= (uint64_t(1) << 32)) {
+                throw std::runtime_error("the text must be shorter than 2^32 bytes");
+            }
+
+            m_size = n;
+            uint64_t N = text.size();
+            std::vector<uint32_t> sa = sort_rotations(text, n);
+
+            std::vector<uint8_t> bwt(N);
+            m_counts.assign(257, 0);
+            bit_vector::builder sampled;
+            std::vector<uint64_t> sampled_ids;
+            // the ID of the string of each sampled text position
+            std::vector<uint32_t> ids_of_samples((N + sample_rate - 1) / sample_rate);
+            for (uint64_t p = 0, id = 0; p < N; ++p) {
+                if (p and text[p] == separator) ++id;
+                if (p % sample_rate == 0) ids_of_samples[p / sample_rate] = id;
+            }
+            for (uint64_t i = 0; i != N; ++i) {
+                uint64_t p = sa[i];
+                bwt[i] = text[p ? p - 1 : N - 1];
+                m_counts[text[p] + 1] += 1;
+                sampled.push_back(p % sample_rate == 0);
+                if (p % sample_rate == 0) sampled_ids.push_back(ids_of_samples[p / sample_rate]);
+            }
+            for (uint64_t c = 0; c != 256; ++c) m_counts[c + 1] += m_counts[c];
+            std::vector<uint32_t>().swap(sa);
+            std::vector<uint8_t>().swap(text);
+
+            m_bwt.build(std::move(bwt));
+            sampled.build(m_sampled);
+            compact_vector::builder ids_builder(sampled_ids.size(), compact_vector::width(n));
+            for (uint64_t i = 0; i != sampled_ids.size(); ++i) ids_builder.set(i, sampled_ids[i]);
+            ids_builder.build(m_sampled_ids);
+        }
+
+        void build(fm_index& index) {
+            index.m_size = m_size;
+            index.m_counts.swap(m_counts);
+            std::swap(index.m_bwt, m_bwt);
+            std::swap(index.m_sampled, m_sampled);
+            std::swap(index.m_sampled_ids, m_sampled_ids);
+            builder().swap(*this);
+        }
+
+        void swap(builder& other) {
+            std::swap(other.m_size, m_size);
+            other.m_counts.swap(m_counts);
+            std::swap(other.m_bwt, m_bwt);
+            std::swap(other.m_sampled, m_sampled);
+            std::swap(other.m_sampled_ids, m_sampled_ids);
+        }
+
+    private:
+        uint64_t m_size;
+        std::vector<uint64_t> m_counts;
+        wavelet_matrix m_bwt;
+        bit_vector m_sampled;
+        compact_vector m_sampled_ids;
+
+        /* Sort the rotations of the text by prefix doubling: after round h, the rotations
+           are sorted by their first 2^h symbols and class[p] is the rank of the 2^h symbols
+           starting at p. As the separators are distinct, no comparison goes past one, so
+           the number of rounds is log2 of the maximum string length (plus one). */
+        static std::vector<uint32_t> sort_rotations(std::vector<uint8_t> const& text,
+                                                    uint64_t n) {
+            uint64_t N = text.size();
+            std::vector<uint32_t> sa(N), tmp(N), classes(N), tmp_classes(N);
+            std::vector<uint32_t> counts(std::max<uint64_t>(N, n + 256) + 1);
+
+            // initial classes: i for the separator $_i, n + c for a byte c
+            for (uint64_t p = 0, id = 0; p != N; ++p) {
+                classes[p] = text[p] == separator ? id++ : n + text[p];
+            }
+            for (uint64_t p = 0; p != N; ++p) counts[classes[p] + 1] += 1;
+            for (uint64_t c = 1; c != counts.size(); ++c) counts[c] += counts[c - 1];
+            for (uint64_t p = 0; p != N; ++p) sa[counts[classes[p]]++] = p;
+            uint64_t num_classes = 0;
+            for (uint64_t i = 0; i != N; ++i) {
+                if (i == 0 or classes[sa[i]] != classes[sa[i - 1]]) ++num_classes;
+                tmp_classes[sa[i]] = num_classes - 1;
+            }
+            classes.swap(tmp_classes);
+
+            for (uint64_t h = 1; h < N and num_classes != N; h *= 2) {
+                // sort by the second half (already sorted), then stably by the first half
+                for (uint64_t i = 0; i != N; ++i) tmp[i] = sa[i] >= h ? sa[i] - h : sa[i] + N - h;
+                std::fill(counts.begin(), counts.begin() + num_classes + 1, 0);
+                for (uint64_t i = 0; i != N; ++i) counts[classes[tmp[i]] + 1] += 1;
+                for (uint64_t c = 1; c <= num_classes; ++c) counts[c] += counts[c - 1];
+                for (uint64_t i = 0; i != N; ++i) sa[counts[classes[tmp[i]]]++] = tmp[i];
+                num_classes = 0;
+                for (uint64_t i = 0; i != N; ++i) {
+                    uint64_t p = sa[i], q = p + h < N ? p + h : p + h - N;
+                    if (i == 0) {
+                        num_classes = 1;
+                    } else {
+                        uint64_t pp = sa[i - 1], qq = pp + h < N ? pp + h : pp + h - N;
+                        if (classes[p] != classes[pp] or classes[q] != classes[qq]) {
+                            ++num_classes;
+                        }
+                    }
+                    tmp_classes[p] = num_classes - 1;
+                }
+                classes.swap(tmp_classes);
+            }
+            return sa;
+        }
+    };
+
+    fm_index() : m_size(0) {}
+
+    // number of strings
+    uint64_t size() const {
+        return m_size;
+    }
+
+    // length of the text (the total length of the strings plus one separator per string)
+    uint64_t text_size() const {
+        return m_bwt.size();
+    }
+
+    /* Number of occurrences of the pattern (a string may contain more than one).
+       The empty pattern occurs at every position of the text. */
+    uint64_t count(byte_range pattern) const {
+        auto [first, last] = rows(pattern);
+        return last - first;
+    }
+
+    // the IDs of the strings that contain the pattern, in increasing order
+    void locate(byte_range pattern, std::vector<uint64_t>& ids) const {
+        ids.clear();
+        if (pattern.begin == pattern.end) {
+            for (uint64_t id = 0; id != size(); ++id) ids.push_back(id);
+            return;
+        }
+        auto [first, last] = rows(pattern);
+        for (uint64_t i = first; i != last; ++i) ids.push_back(id_of_row(i));
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    }
+
+    uint64_t bytes() const {
+        return m_counts.size() * sizeof(m_counts.front()) + m_bwt.bytes() + m_sampled.bytes() +
+               m_sampled_ids.bytes();
+    }
+
+private:
+    uint64_t m_size;
+    std::vector<uint64_t> m_counts;  // number of BWT symbols smaller than c, for c = 0..256
+    wavelet_matrix m_bwt;
+    bit_vector m_sampled;
+    compact_vector m_sampled_ids;
+
+    // the rows [first, last) of the rotations starting with the pattern (backward search)
+    std::pair<uint64_t, uint64_t> rows(byte_range pattern) const {
+        uint64_t first = 0, last = text_size();
+        for (uint8_t const* p = pattern.end; p != pattern.begin and first != last;) {
+            uint8_t c = *--p;
+            if (c == separator) return {0, 0};
+            first = m_counts[c] + m_bwt.rank(c, first);
+            last = m_counts[c] + m_bwt.rank(c, last);
+        }
+        return {first, last};
+    }
+
+    // the ID of the string containing the first symbol of the rotation of row i
+    uint64_t id_of_row(uint64_t i) const {
+        while (true) {
+            if (m_sampled[i]) return m_sampled_ids[m_sampled.rank1(i)];
+            uint64_t rank = 0;
+            uint8_t c = m_bwt.access(i, &rank);
+            // the rotation starts with s_id, and rows [0, n) start with $_0, ..., $_{n-1}
+            if (c == separator) return rank;
+            i = m_counts[c] + rank;
+        }
+    }
+};
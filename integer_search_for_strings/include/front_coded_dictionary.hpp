@@ -1,115 +1,352 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <queue>
 
 #include "util.hpp"
-
-template <uint64_t BucketSize>
+#include "front_coding.hpp"
+#include "symbol_table.hpp"
+#include "tracing.hpp"
+
+/* Front coding: strings are grouped into buckets of BucketSize + 1 strings;
+   the first string of each bucket (the header) is stored verbatim and the others
+   as (|lcp|, suffix length, suffix), where the lcp is taken with the previous string.
+   Both lengths are encoded as varints, so that strings can be arbitrarily long
+   (a single byte is used for lengths smaller than 128).
+
+   If IntegerKeys is true, each entry also stores the (big-endian) integer formed by
+   the first 8 bytes of its suffix (zero-padded), in place of such bytes:
+   (|lcp|, suffix length, key, remaining suffix bytes).
+
+   The search within a bucket keeps track of |lcp(string, previous entry)| and
+   only compares the entries having the same lcp (using the keys, if present):
+   the scan terminates as soon as an entry has a smaller lcp and nothing is decoded.
+
+   The suffix codec is chosen per instance at build time. With suffix_codec::fsst, a
+   symbol_table is learned from a sample of the suffixes and each entry is stored as
+   (|lcp|, encoded length, codes); the search compares the codes with the query without
+   decoding them. This codec cannot be combined with IntegerKeys.
+
+   The probes of lookup and lower_bound are reported to a Tracer (see tracing.hpp): the
+   headers and their offsets compared during the binary search, then the entries scanned
+   in the bucket (their lengths and, for the compared entries, the whole payload). */
+
+template <uint64_t BucketSize, bool IntegerKeys = false, typename Tracer = no_tracer>
 struct front_coded_dictionary {
     struct builder {
-        builder() {}
+        builder(suffix_codec codec = suffix_codec::plain)
+            : m_size(0), m_max_string_length(0), m_codec(codec) {
+            m_headers_offsets.push_back(0);
+            if (IntegerKeys and codec != suffix_codec::plain) {
+                throw std::runtime_error("integer keys require the plain suffix codec");
+            }
+        }
 
         template <typename Iterator>
         void build(Iterator begin, uint64_t n) {
-            m_size = n;
             uint64_t buckets = std::ceil(static_cast<double>(n) / (BucketSize + 1));
-            uint64_t tail = n - ((n / (BucketSize + 1)) * (BucketSize + 1));
-            if (tail) tail -= 1;  // remove header
 
             std::cout << "n " << n << std::endl;
             std::cout << "buckets " << buckets << std::endl;
 
+            if (m_codec == suffix_codec::fsst) {
+                build_table(begin, n);
+                std::cout << "num. symbols " << m_table.size() << std::endl;
+            }
+
             m_headers_offsets.reserve(buckets + 1);
             m_buckets_offsets.reserve(buckets + 1);
-            m_headers_offsets.push_back(0);
-            m_buckets_offsets.push_back(0);
+            for (uint64_t i = 0; i != n; ++i, ++begin) {
+                std::string const& string = *begin;
+                append(byte_range_from_string(string));
+            }
+
+            std::cout << "DONE" << std::endl;
+        }
+
+        /* Merge the (sorted) strings of the inputs, removing duplicates, with a k-way merge
+           that decodes each input sequentially. remaps[k][i] is set to the ID, in the merged
+           dictionary, of the string of ID i in inputs[k]. The inputs must have the same
+           template parameters but can have different codecs. The merged dictionary is then
+           obtained with build(dict) as usual. */
+        void merge(std::vector<front_coded_dictionary const*> const& inputs,
+                   std::vector<std::vector<uint64_t>>& remaps) {
+            assert(m_size == 0);
+            if (m_codec == suffix_codec::fsst) {
+                build_table(inputs);
+                std::cout << "num. symbols " << m_table.size() << std::endl;
+            }
+
+            uint64_t k = inputs.size();
+            remaps.resize(k);
+            std::vector<iterator> its, ends;
+            for (auto input : inputs) {
+                its.push_back(input->begin());
+                ends.push_back(input->end());
+            }
+            // min-heap of the inputs, by their current string (ties broken by input)
+            auto greater = [&](uint64_t x, uint64_t y) {
+                int cmp = byte_range_compare(*its[x], *its[y]);
+                return cmp > 0 or (cmp == 0 and x > y);
+            };
+            std::priority_queue<uint64_t, std::vector<uint64_t>, decltype(greater)> heap(greater);
+            for (uint64_t i = 0; i != k; ++i) {
+                remaps[i].resize(inputs[i]->size());
+                if (its[i] != ends[i]) heap.push(i);
+            }
+            while (!heap.empty()) {
+                uint64_t i = heap.top();
+                heap.pop();
+                byte_range string = *its[i];
+                if (m_size == 0 or byte_range_compare(byte_range_from_string(m_prev), string)) {
+                    append(string);
+                }
+                remaps[i][its[i].id()] = m_size - 1;
+                if (++its[i] != ends[i]) heap.push(i);
+            }
 
-            std::string prev, curr, header;
-            for (uint64_t b = 0; b != buckets; ++b) {
-                header = *begin++;
-                m_headers.insert(m_headers.end(), header.begin(), header.end());
-                static const uint64_t max_addressable_size = uint64_t(1) << 32;
+            std::cout << "merged " << k << " dictionaries into " << m_size << " strings"
+                      << std::endl;
+        }
+
+        /* Append a string, greater than the previous one. Strings can also be appended
+           one at a time, without knowing their number in advance (but not with the
+           suffix_codec::fsst codec, whose table is learned by build and merge). */
+        void append(byte_range string) {
+            static const uint64_t max_addressable_size = uint64_t(1) << 32;
+            uint64_t size = string.end - string.begin;
+            m_max_string_length = std::max(m_max_string_length, size);
+            if (m_size++ % (BucketSize + 1) == 0) {  // header
+                m_buckets_offsets.push_back(m_data.size());
+                m_headers.insert(m_headers.end(), string.begin, string.end);
                 if (m_headers.size() >= max_addressable_size) {
                     throw std::runtime_error(
                         "Error: offsets to headers must be made 64-bit "
                         "integers");
                 }
                 m_headers_offsets.push_back(m_headers.size());
-                prev.swap(header);
-                uint64_t size = b != buckets - 1 ? BucketSize : tail;
-                for (uint64_t i = 0; i != size; ++i) {
-                    curr = *begin++;
-                    uint64_t l = 0;  // |lcp(curr,prev)|
-                    while (l != curr.size() and l != prev.size() and curr[l] == prev[l]) { ++l; }
-                    assert(l < 256);
-                    m_data.push_back(l);
-                    uint64_t size = curr.size();
-                    assert(size >= l);
-                    m_data.push_back(size - l);
-                    m_data.insert(m_data.end(), curr.begin() + l, curr.end());
-                    prev.swap(curr);
-                }
-                if (m_data.size() >= max_addressable_size) {
-                    throw std::runtime_error(
-                        "Error: offsets to buckets must be made 64-bit "
-                        "integers");
-                }
-                m_buckets_offsets.push_back(m_data.size());
+                m_prev.assign(string.begin, string.end);
+                return;
             }
 
-            // NOTE: pad to allow fixed-copy operations
-            for (uint64_t i = 0; i != constants::max_string_length - 1; ++i) {
-                m_headers.push_back(0);
-                m_data.push_back(0);
+            uint64_t l = simd::lcp(string.begin, reinterpret_cast<uint8_t const*>(m_prev.data()),
+                                   std::min<uint64_t>(size, m_prev.size()));
+            write_varint(m_data, l);
+            if (m_codec == suffix_codec::fsst) {
+                m_codes.clear();
+                m_table.encode({string.begin + l, string.end}, m_codes);
+                write_varint(m_data, m_codes.size());
+                m_data.insert(m_data.end(), m_codes.begin(), m_codes.end());
+            } else {
+                write_varint(m_data, size - l);
+                uint64_t skipped = 0;
+                if constexpr (IntegerKeys) {
+                    uint64_t key = integer_prefix<64>::from(byte_range{string.begin + l, string.end});
+                    m_data.insert(m_data.end(), reinterpret_cast<uint8_t const*>(&key),
+                                  reinterpret_cast<uint8_t const*>(&key) + sizeof(key));
+                    skipped = std::min<uint64_t>(size - l, sizeof(key));
+                }
+                m_data.insert(m_data.end(), string.begin + l + skipped, string.end);
             }
-
-            std::cout << "DONE" << std::endl;
+            if (m_data.size() >= max_addressable_size) {
+                throw std::runtime_error(
+                    "Error: offsets to buckets must be made 64-bit "
+                    "integers");
+            }
+            m_prev.assign(string.begin, string.end);
         }
 
         void swap(builder& other) {
             std::swap(other.m_size, m_size);
+            std::swap(other.m_max_string_length, m_max_string_length);
+            std::swap(other.m_codec, m_codec);
+            std::swap(other.m_table, m_table);
             other.m_headers_offsets.swap(m_headers_offsets);
             other.m_buckets_offsets.swap(m_buckets_offsets);
             other.m_headers.swap(m_headers);
             other.m_data.swap(m_data);
+            other.m_prev.swap(m_prev);
         }
 
         void build(front_coded_dictionary& dict) {
+            m_buckets_offsets.push_back(m_data.size());  // end of the last bucket
             dict.m_size = m_size;
+            dict.m_max_string_length = m_max_string_length;
+            dict.m_codec = m_codec;
+            std::swap(dict.m_table, m_table);
             dict.m_headers_offsets.swap(m_headers_offsets);
             dict.m_buckets_offsets.swap(m_buckets_offsets);
             dict.m_headers.swap(m_headers);
             dict.m_data.swap(m_data);
-            builder().swap(*this);
+            builder(m_codec).swap(*this);
         }
 
     private:
         uint64_t m_size;
+        uint64_t m_max_string_length;
+        suffix_codec m_codec;
+        symbol_table m_table;
+        std::vector<uint8_t> m_codes;  // codes of the current suffix
         std::vector<uint32_t> m_headers_offsets;
         std::vector<uint32_t> m_buckets_offsets;
         std::vector<uint8_t> m_headers;
         std::vector<uint8_t> m_data;
+        std::string m_prev;  // the last appended string
+
+        // learn the symbol table from (at most max_sample_size) suffixes of non-header strings
+        template <typename Iterator>
+        void build_table(Iterator begin, uint64_t n) {
+            static const uint64_t max_sample_size = uint64_t(1) << 14;
+            uint64_t step = std::max<uint64_t>(1, n / max_sample_size);
+            std::vector<std::string> sample;
+            std::string prev;
+            for (uint64_t i = 0, j = 0; i != n; ++i, ++begin) {
+                std::string const& curr = *begin;
+                if (i % (BucketSize + 1) != 0 and j++ % step == 0) {
+                    sample.push_back(curr.substr(string_lcp(curr, prev)));
+                }
+                prev = curr;
+            }
+            m_table.build(sample);
+        }
+
+        // as above, from the inputs of a merge
+        void build_table(std::vector<front_coded_dictionary const*> const& inputs) {
+            static const uint64_t max_sample_size = uint64_t(1) << 14;
+            uint64_t n = 0;
+            for (auto input : inputs) n += input->size();
+            uint64_t step = std::max<uint64_t>(1, n / max_sample_size);
+            std::vector<std::string> sample;
+            uint64_t j = 0;
+            for (auto input : inputs) {
+                std::string prev;
+                for (auto it = input->begin(); it != input->end(); ++it) {
+                    std::string curr((*it).begin, (*it).end);
+                    if (it.id() % (BucketSize + 1) != 0 and j++ % step == 0) {
+                        sample.push_back(curr.substr(string_lcp(curr, prev)));
+                    }
+                    prev.swap(curr);
+                }
+            }
+            m_table.build(sample);
+        }
     };
 
+    /* Decodes the strings in order, one entry at a time (each bucket is decoded once).
+       The string returned by operator* is valid until the iterator is incremented. */
+    struct iterator {
+        iterator(front_coded_dictionary const* dict, uint64_t id)
+            : m_dict(dict), m_id(id), m_size(0), m_curr(nullptr) {
+            if (m_id == m_dict->size()) return;
+            m_string.resize(m_dict->max_string_length() + symbol_table::slack);
+            uint64_t bucket = m_id / (BucketSize + 1);
+            load_header(bucket);
+            m_curr = m_dict->m_data.data() + m_dict->m_buckets_offsets[bucket];
+            for (uint64_t i = 0; i != m_id % (BucketSize + 1); ++i) {
+                m_size = m_dict->decode(m_curr, m_string.data());
+            }
+        }
+
+        byte_range operator*() const {
+            assert(m_id < m_dict->size());
+            return {m_string.data(), m_string.data() + m_size};
+        }
+
+        iterator& operator++() {
+            if (++m_id == m_dict->size()) return *this;
+            if (m_id % (BucketSize + 1) == 0) {
+                uint64_t bucket = m_id / (BucketSize + 1);
+                load_header(bucket);
+                m_curr = m_dict->m_data.data() + m_dict->m_buckets_offsets[bucket];
+            } else {
+                m_size = m_dict->decode(m_curr, m_string.data());
+            }
+            return *this;
+        }
+
+        uint64_t id() const {
+            return m_id;
+        }
+
+        bool operator==(iterator const& other) const {
+            return m_id == other.m_id;
+        }
+
+        bool operator!=(iterator const& other) const {
+            return m_id != other.m_id;
+        }
+
+    private:
+        front_coded_dictionary const* m_dict;
+        uint64_t m_id;
+        uint64_t m_size;
+        uint8_t const* m_curr;  // next entry
+        std::vector<uint8_t> m_string;
+
+        void load_header(uint64_t bucket) {
+            byte_range header = m_dict->access_header(bucket);
+            m_size = header.end - header.begin;
+            std::copy(header.begin, header.end, m_string.data());
+        }
+    };
+
+    iterator begin() const {
+        return iterator(this, 0);
+    }
+
+    iterator end() const {
+        return iterator(this, size());
+    }
+
+    front_coded_dictionary()
+        : m_size(0), m_max_string_length(0), m_codec(suffix_codec::plain) {}
+
     template <typename Visitor>
     void visit(Visitor& visitor) {
         visitor.visit(m_size);
+        visitor.visit(m_max_string_length);
+        visitor.visit(m_codec);
+        visitor.visit(m_table);
         visitor.visit(m_headers_offsets);
         visitor.visit(m_buckets_offsets);
         visitor.visit(m_headers);
         visitor.visit(m_data);
+        visitor.visit(m_hot_buckets);
+        visitor.visit(m_hot_flags);
+        visitor.visit(m_hot_headers_offsets);
+        visitor.visit(m_hot_headers);
     }
 
     uint64_t size() const {
         return m_size;
     }
 
+    /* The output buffer of access(id, string) must hold at least these many bytes,
+       plus symbol_table::slack if the codec is suffix_codec::fsst. */
+    uint64_t max_string_length() const {
+        return m_max_string_length;
+    }
+
+    suffix_codec codec() const {
+        return m_codec;
+    }
+
+    void set_tracer(Tracer tracer) {
+        m_tracer = tracer;
+    }
+
+    Tracer const& tracer() const {
+        return m_tracer;
+    }
+
     uint64_t lookup(byte_range string) const {
         auto [header, string_is_header, bucket] = locate_bucket(string);
         uint64_t base = bucket * (BucketSize + 1);
         if (string_is_header) return base;
+        if (bucket == 0 and byte_range_compare(header, string) > 0) return constants::invalid_id;
         uint64_t offset = lookup(string, header, bucket);
         if (offset == constants::invalid_id) return constants::invalid_id;
         return base + offset;
@@ -119,9 +356,8 @@ struct front_coded_dictionary {
         auto [header, string_is_header, bucket] = locate_bucket(string);
         uint64_t base = bucket * (BucketSize + 1);
         if (string_is_header) return base;
-        uint64_t offset = lower_bound(string, header, bucket);
-        if (offset == constants::invalid_id) return constants::invalid_id;
-        return base + offset;
+        if (bucket == 0 and byte_range_compare(header, string) > 0) return 0;
+        return base + lower_bound(string, header, bucket);
     }
 
     uint64_t access(uint64_t id, uint8_t* string) const {
@@ -131,22 +367,164 @@ struct front_coded_dictionary {
         return access(bucket, offset, string);
     }
 
-    // byte_range access(uint64_t id) const {
-    //     static uint8_t string[2 * constants::max_string_length];
-    //     uint64_t size = access(id, string);
-    //     return {string, string + size};
-    // }
-
     std::string access(uint64_t id) const {
         std::string string;
-        string.resize(2 * constants::max_string_length);
+        string.resize(m_max_string_length + symbol_table::slack);
         uint64_t size = access(id, reinterpret_cast<uint8_t*>(string.data()));
         string.resize(size);
         return string;
     }
 
+    /* Decode the strings of the n given IDs (in any order, possibly repeated) into arena,
+       contiguously: the i-th string is arena[offsets[i], offsets[i + 1]).
+       The IDs are decoded in sorted order, so that decoding resumes from the previous ID
+       when it is in the same bucket: each bucket is decoded with a single pass. If the IDs
+       are not sorted, the (id, i) pairs are sorted first and the strings are then copied
+       to their positions. */
+    void access(uint64_t const* ids, uint64_t n, std::vector<uint8_t>& arena,
+                std::vector<uint64_t>& offsets) const {
+        arena.clear();
+        offsets.assign(1, 0);
+        offsets.reserve(n + 1);
+        bool group = !std::is_sorted(ids, ids + n);
+        std::vector<std::pair<uint64_t, uint64_t>> order;  // (id, i)
+        std::vector<std::pair<uint64_t, uint64_t>> ranges;  // of each string in decoded
+        std::vector<uint8_t> decoded;                       // in sorted order
+        if (group) {
+            order.reserve(n);
+            for (uint64_t i = 0; i != n; ++i) order.emplace_back(ids[i], i);
+            std::sort(order.begin(), order.end());
+            ranges.resize(n);
+        }
+        std::vector<uint8_t>& out = group ? decoded : arena;
+
+        std::vector<uint8_t> string(m_max_string_length + symbol_table::slack);
+        uint64_t bucket = buckets();
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint8_t const* curr = nullptr;
+        for (uint64_t j = 0; j != n; ++j) {
+            uint64_t i = group ? order[j].second : j;
+            assert(ids[i] < this->size());
+            uint64_t b = ids[i] / (BucketSize + 1);
+            uint64_t o = ids[i] % (BucketSize + 1);
+            if (b != bucket or o < offset) {
+                bucket = b;
+                offset = 0;
+                byte_range header = access_header(b);
+                size = header.end - header.begin;
+                memcpy(string.data(), header.begin, size);
+                curr = m_data.data() + m_buckets_offsets[b];
+            }
+            for (; offset != o; ++offset) size = decode(curr, string.data());
+            out.insert(out.end(), string.data(), string.data() + size);
+            if (group) {
+                ranges[i] = {out.size() - size, out.size()};
+            } else {
+                offsets.push_back(arena.size());
+            }
+        }
+        if (!group) return;
+
+        arena.reserve(decoded.size());
+        for (auto [begin, end] : ranges) {
+            arena.insert(arena.end(), decoded.data() + begin, decoded.data() + end);
+            offsets.push_back(arena.size());
+        }
+    }
+
+    /* Optional: lay out the dictionary for the distribution of the queries in the given log
+       (IDs do not change). The (at most) max_hot_buckets buckets where most queries of the
+       log end up are moved to the beginning of m_data, contiguously, and their headers
+       (with the headers of the buckets that follow them, as fences) are copied into a small
+       sorted array that is searched before the headers: a query falling into a hot bucket
+       never touches the (cold) headers. An empty log (or max_hot_buckets = 0) only clears
+       the hot layout. */
+    template <typename Iterator>
+    void build_hot_layout(Iterator queries, uint64_t num_queries, uint64_t max_hot_buckets) {
+        clear_hot_layout();
+        if (num_queries == 0 or max_hot_buckets == 0) return;
+        std::vector<uint64_t> counts(buckets(), 0);
+        for (uint64_t i = 0; i != num_queries; ++i, ++queries) {
+            std::string const& query = *queries;
+            counts[std::get<2>(locate_bucket(byte_range_from_string(query)))] += 1;
+        }
+        std::vector<uint64_t> hot(buckets());
+        for (uint64_t b = 0; b != buckets(); ++b) hot[b] = b;
+        std::stable_sort(hot.begin(), hot.end(),
+                         [&](uint64_t x, uint64_t y) { return counts[x] > counts[y]; });
+        uint64_t num_hot = 0, covered = 0;
+        while (num_hot != std::min(max_hot_buckets, buckets()) and counts[hot[num_hot]]) {
+            covered += counts[hot[num_hot++]];
+        }
+        hot.resize(num_hot);
+        std::sort(hot.begin(), hot.end());
+        std::vector<bool> is_hot(buckets(), false);
+        for (auto b : hot) is_hot[b] = true;
+
+        uint64_t lines_before = cache_lines(hot);
+        std::vector<uint8_t> data;
+        data.reserve(m_data.size());
+        std::vector<uint32_t> offsets(m_buckets_offsets.size());
+        for (bool hot_pass : {true, false}) {
+            for (uint64_t b = 0; b != buckets(); ++b) {
+                if (is_hot[b] != hot_pass) continue;
+                uint8_t const* begin = m_data.data() + m_buckets_offsets[b];
+                offsets[b] = data.size();
+                data.insert(data.end(), begin, begin + bucket_bytes(b));
+            }
+        }
+        offsets.back() = data.size();
+        m_data.swap(data);
+        m_buckets_offsets.swap(offsets);
+        uint64_t lines_after = cache_lines(hot);
+
+        m_hot_headers_offsets.push_back(0);
+        for (uint64_t b = 0; b != buckets(); ++b) {
+            if (!is_hot[b] and !(b and is_hot[b - 1])) continue;
+            byte_range header = access_header(b);
+            m_hot_buckets.push_back(b);
+            m_hot_flags.push_back(is_hot[b]);
+            m_hot_headers.insert(m_hot_headers.end(), header.begin, header.end);
+            m_hot_headers_offsets.push_back(m_hot_headers.size());
+        }
+
+        std::cout << "hot buckets " << num_hot << " (" << covered * 100.0 / num_queries
+                  << "% of the queries); cache lines of their data: " << lines_before
+                  << " before, " << lines_after << " after; searched headers: "
+                  << hot_bytes() << " bytes instead of "
+                  << m_headers.size() + m_headers_offsets.size() * sizeof(m_headers_offsets.front())
+                  << std::endl;
+    }
+
+    void clear_hot_layout() {
+        m_hot_buckets.clear();
+        m_hot_flags.clear();
+        m_hot_headers_offsets.clear();
+        m_hot_headers.clear();
+    }
+
+    // space taken by the hot-header array
+    uint64_t hot_bytes() const {
+        return m_hot_buckets.size() * sizeof(m_hot_buckets.front()) +
+               m_hot_flags.size() * sizeof(m_hot_flags.front()) +
+               m_hot_headers_offsets.size() * sizeof(m_hot_headers_offsets.front()) +
+               m_hot_headers.size() * sizeof(m_hot_headers.front());
+    }
+
+    uint64_t bytes() const {
+        return m_headers_offsets.size() * sizeof(m_headers_offsets.front()) +
+               m_buckets_offsets.size() * sizeof(m_buckets_offsets.front()) +
+               m_headers.size() * sizeof(m_headers.front()) +
+               m_data.size() * sizeof(m_data.front()) +
+               (m_codec == suffix_codec::fsst ? m_table.bytes() : 0) + hot_bytes();
+    }
+
 private:
     uint64_t m_size;
+    uint64_t m_max_string_length;
+    suffix_codec m_codec;
+    symbol_table m_table;
 
     // NOTE: these two can be stored interleaved
     std::vector<uint32_t> m_headers_offsets;
@@ -155,6 +533,15 @@ private:
     std::vector<uint8_t> m_headers;
     std::vector<uint8_t> m_data;
 
+    // hot-header array (see build_hot_layout): sorted bucket IDs and their headers,
+    // with a flag telling whether a bucket is hot or only the fence of the previous one
+    std::vector<uint32_t> m_hot_buckets;
+    std::vector<uint8_t> m_hot_flags;
+    std::vector<uint32_t> m_hot_headers_offsets;
+    std::vector<uint8_t> m_hot_headers;
+
+    Tracer m_tracer;
+
     uint64_t buckets() const {
         assert(m_headers_offsets.size() > 0);
         return m_headers_offsets.size() - 1;
@@ -162,9 +549,8 @@ private:
 
     uint64_t bucket_size(uint64_t bucket) const {
         if (bucket != buckets() - 1) return BucketSize;
-        uint64_t tail = size() - ((size() / (BucketSize + 1)) * (BucketSize + 1));
-        if (tail) tail -= 1;
-        return tail;
+        uint64_t tail = size() % (BucketSize + 1);
+        return tail ? tail - 1 : BucketSize;
     }
 
     byte_range access_header(uint64_t id) const {
@@ -174,7 +560,64 @@ private:
         return {m_headers.data() + begin, m_headers.data() + end};
     }
 
+    // number of bytes taken by the entries of a bucket
+    uint64_t bucket_bytes(uint64_t bucket) const {
+        uint8_t const* begin = m_data.data() + m_buckets_offsets[bucket];
+        uint8_t const* curr = begin;
+        for (uint64_t i = 0; i != bucket_size(bucket); ++i) {
+            read_varint(curr);
+            uint64_t suffix_len = read_varint(curr);  // or number of codes
+            curr += m_codec == suffix_codec::fsst ? suffix_len : payload_bytes(suffix_len);
+        }
+        return curr - begin;
+    }
+
+    // number of distinct cache lines spanned by the entries of the given buckets
+    uint64_t cache_lines(std::vector<uint64_t> const& buckets) const {
+        static const uint64_t line_size = 64;
+        std::vector<uint64_t> lines;
+        for (auto b : buckets) {
+            uint64_t begin = reinterpret_cast<uintptr_t>(m_data.data()) + m_buckets_offsets[b];
+            uint64_t end = begin + bucket_bytes(b);
+            for (uint64_t line = begin / line_size; line * line_size < end; ++line) {
+                lines.push_back(line);
+            }
+        }
+        std::sort(lines.begin(), lines.end());
+        return std::unique(lines.begin(), lines.end()) - lines.begin();
+    }
+
+    byte_range access_hot_header(uint64_t i) const {
+        uint64_t begin = m_hot_headers_offsets[i];
+        uint64_t end = m_hot_headers_offsets[i + 1];
+        return {m_hot_headers.data() + begin, m_hot_headers.data() + end};
+    }
+
     std::tuple<byte_range, bool, int> locate_bucket(byte_range string) const {
+        if (!m_hot_buckets.empty()) {
+            // the last hot header <= string
+            uint64_t lo = 0, hi = m_hot_buckets.size();
+            while (lo < hi) {
+                uint64_t mi = (lo + hi) / 2;
+                byte_range header = access_hot_header(mi);
+                m_tracer.probe(&m_hot_headers_offsets[mi], 2 * sizeof(uint32_t));
+                trace_compare(m_tracer, header, string);
+                if (byte_range_compare(header, string) <= 0) {
+                    lo = mi + 1;
+                } else {
+                    hi = mi;
+                }
+            }
+            // the next header (if any) is in the array and is > string
+            if (lo) m_tracer.probe(&m_hot_flags[lo - 1], sizeof(uint8_t));
+            if (lo and m_hot_flags[lo - 1]) {
+                m_tracer.probe(&m_hot_buckets[lo - 1], sizeof(uint32_t));
+                byte_range header = access_hot_header(lo - 1);
+                bool string_is_header = byte_range_compare(header, string) == 0;
+                return {header, string_is_header, m_hot_buckets[lo - 1]};
+            }
+        }
+
         int lo = 0, hi = buckets() - 1, mi = 0, cmp = 0;
 
         byte_range header;
@@ -184,6 +627,8 @@ private:
         while (lo <= hi) {
             mi = (lo + hi) / 2;
             header = access_header(mi);
+            m_tracer.probe(&m_headers_offsets[mi], 2 * sizeof(uint32_t));
+            trace_compare(m_tracer, header, string);
             cmp = byte_range_compare(header, string);
             if (cmp > 0) {
                 hi = mi - 1;
@@ -199,6 +644,8 @@ private:
         } else {
             bucket = hi == -1 ? 0 : hi;
             header = access_header(bucket);
+            m_tracer.probe(&m_headers_offsets[bucket], 2 * sizeof(uint32_t));
+            m_tracer.probe(header.begin, header.end - header.begin);
         }
         return {header, false, bucket};
 
@@ -222,56 +669,100 @@ private:
         // return {header, byte_range_compare(header, string) == 0, base};
     }
 
-    uint8_t decode(uint8_t const* in, uint8_t* out, uint8_t* lcp_len) const {
-        *lcp_len = *in++;
-        uint8_t l = *lcp_len;
-        uint8_t suffix_len = *in++;
-        memcpy(out + l, in, constants::max_string_length);
-        return l + suffix_len;
+    /* Decode the entry pointed to by in, given the previous string in out,
+       and return the size of the decoded string. The pointer in is moved to the next entry. */
+    uint64_t decode(uint8_t const*& in, uint8_t* out) const {
+        uint64_t lcp_len = read_varint(in);
+        if (m_codec == suffix_codec::fsst) {
+            uint64_t codes = read_varint(in);
+            uint8_t* end = m_table.decode(in, in + codes, out + lcp_len);
+            in += codes;
+            return end - out;
+        }
+        uint64_t suffix_len = read_varint(in);
+        if constexpr (IntegerKeys) {
+            uint64_t key;
+            memcpy(&key, in, sizeof(key));
+            key = __builtin_bswap64(key);
+            memcpy(out + lcp_len, &key, std::min<uint64_t>(suffix_len, sizeof(key)));
+        }
+        memcpy(out + lcp_len + skipped_bytes(suffix_len), in + stored_key_bytes(),
+               suffix_len - skipped_bytes(suffix_len));
+        in += payload_bytes(suffix_len);
+        return lcp_len + suffix_len;
     }
 
-    uint64_t lower_bound(byte_range string, byte_range header, uint64_t bucket) const {
-        static uint8_t decoded[2 * constants::max_string_length];
-        memcpy(decoded, header.begin, constants::max_string_length);
-        uint64_t n = bucket_size(bucket);
-        uint8_t lcp_len;
-        uint8_t const* curr = m_data.data() + m_buckets_offsets[bucket];
-        for (uint64_t i = 0; i != n; ++i) {
-            uint8_t l = decode(curr, decoded, &lcp_len);
-            int cmp = byte_range_compare(string, {decoded, decoded + l});
-            if (cmp <= 0) return i + 1;
-            curr += l - lcp_len + 2;
+    static constexpr uint64_t stored_key_bytes() {
+        return IntegerKeys ? sizeof(uint64_t) : 0;
+    }
+
+    // number of suffix bytes that are only represented by the key
+    static uint64_t skipped_bytes(uint64_t suffix_len) {
+        return std::min(suffix_len, stored_key_bytes());
+    }
+
+    // bytes following the (|lcp|, suffix length) header of an entry
+    static uint64_t payload_bytes(uint64_t suffix_len) {
+        return stored_key_bytes() + suffix_len - skipped_bytes(suffix_len);
+    }
+
+    /* Compare the suffix of an entry, whose payload is at p, with the string q,
+       and set lcp to |lcp(suffix, q)|. NOTE: in both formats, the byte j of the suffix
+       is stored at p + j, if j is not represented by the key. */
+    static int compare_suffix(uint8_t const* p, uint64_t suffix_len, uint8_t const* q,
+                              uint64_t q_len, uint64_t* lcp) {
+        uint64_t l = std::min(suffix_len, q_len);
+        uint64_t k = 0;
+        if constexpr (IntegerKeys) {
+            uint64_t key;
+            memcpy(&key, p, sizeof(key));
+            uint64_t q_key = integer_prefix<64>::from(byte_range{q, q + q_len});
+            if (key != q_key) {
+                *lcp = std::min<uint64_t>(__builtin_clzll(key ^ q_key) >> 3, l);
+                return key < q_key ? -1 : 1;
+            }
+            k = std::min<uint64_t>(l, sizeof(key));
         }
-        return constants::invalid_id;
+        k += simd::lcp(p + k, q + k, l - k);
+        *lcp = k;
+        if (k != l) return int(p[k]) - int(q[k]);
+        return (suffix_len > q_len) - (suffix_len < q_len);
     }
 
-    uint64_t lookup(byte_range string, byte_range header, uint64_t bucket) const {
-        static uint8_t decoded[2 * constants::max_string_length];
-        memcpy(decoded, header.begin, constants::max_string_length);
-        uint64_t n = bucket_size(bucket);
-        uint8_t lcp_len;
-        uint8_t const* curr = m_data.data() + m_buckets_offsets[bucket];
-        for (uint64_t i = 0; i != n; ++i) {
-            uint8_t l = decode(curr, decoded, &lcp_len);
-            int cmp = byte_range_compare(string, {decoded, decoded + l});
-            if (cmp == 0) return i + 1;
-            if (cmp < 0) return constants::invalid_id;
-            curr += l - lcp_len + 2;
+    /* Return the position, within the bucket, of the first string that is >= string
+       (the header being at position 0). If found is not null, it is set to true if such
+       string is equal to string. Requires header < string. */
+    uint64_t search(byte_range string, byte_range header, uint64_t bucket, bool* found) const {
+        m_tracer.probe(&m_buckets_offsets[bucket], sizeof(uint32_t));
+        uint8_t const* data = m_data.data() + m_buckets_offsets[bucket];
+        if (m_codec == suffix_codec::fsst) {
+            return front_coded_search(
+                data, bucket_size(bucket), string, header, m_tracer, found,
+                [&](uint8_t const* p, uint64_t codes, uint8_t const* q, uint64_t q_len,
+                    uint64_t* lcp) { return m_table.compare(p, p + codes, {q, q + q_len}, lcp); },
+                [](uint64_t codes) { return codes; });
         }
-        return constants::invalid_id;
+        return front_coded_search(data, bucket_size(bucket), string, header, m_tracer, found,
+                                  compare_suffix, payload_bytes);
+    }
+
+    uint64_t lower_bound(byte_range string, byte_range header, uint64_t bucket) const {
+        return search(string, header, bucket, nullptr);
+    }
+
+    uint64_t lookup(byte_range string, byte_range header, uint64_t bucket) const {
+        bool found = false;
+        uint64_t i = search(string, header, bucket, &found);
+        return found ? i : constants::invalid_id;
     }
 
     uint64_t access(uint64_t bucket, uint64_t id, uint8_t* string) const {
         assert(id <= bucket_size(bucket));
         byte_range header = access_header(bucket);
-        memcpy(string, header.begin, constants::max_string_length);
-        uint8_t lcp_len;
-        uint8_t const* curr = m_data.data() + m_buckets_offsets[bucket];
         uint64_t size = header.end - header.begin;
-        for (uint64_t i = 1; i <= id; ++i) {
-            size = decode(curr, string, &lcp_len);
-            curr += size - lcp_len + 2;
-        }
+        memcpy(string, header.begin, size);
+        uint8_t const* curr = m_data.data() + m_buckets_offsets[bucket];
+        for (uint64_t i = 1; i <= id; ++i) size = decode(curr, string);
         return size;
     }
 };
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+
+#include "util.hpp"
+
+/* The scan of a front-coded bucket, shared by front_coded_dictionary,
+   prefix_indexed_front_coded_dictionary and external_front_coded_dictionary.
+
+   The n entries of the bucket start at data; each is (|lcp|, suffix length, payload), with
+   both lengths as varints and the lcp taken with the previous string (the header for the
+   first entry). The scan keeps track of m = |lcp(string, previous entry)| and only compares
+   the entries whose lcp is m: an entry with a smaller lcp is > string, and one with a
+   larger lcp is < string.
+
+   compare_suffix(payload, suffix_len, q, q_len, &lcp) compares the suffix of an entry with
+   the string q and sets lcp to |lcp(suffix, q)|; payload_bytes(suffix_len) is the size of
+   the payload. The overload without them is for plain suffixes, stored verbatim. */
+
+/* Return the position, within the bucket, of the first string that is >= string
+   (the header being at position 0). If found is not null, it is set to true if such
+   string is equal to string. Requires header < string. */
+template <typename Tracer, typename SuffixCompare, typename PayloadBytes>
+uint64_t front_coded_search(uint8_t const* data, uint64_t n, byte_range string, byte_range header,
+                            Tracer const& tracer, bool* found, SuffixCompare compare_suffix,
+                            PayloadBytes payload_bytes) {
+    uint64_t string_size = string.end - string.begin;
+    // |lcp(string, previous entry)|, with previous entry < string
+    uint64_t m = simd::lcp(header.begin, string.begin,
+                           std::min<uint64_t>(header.end - header.begin, string_size));
+    uint8_t const* curr = data;
+    for (uint64_t i = 0; i != n; ++i) {
+        uint8_t const* entry = curr;
+        uint64_t lcp_len = read_varint(curr);
+        uint64_t suffix_len = read_varint(curr);
+        uint64_t payload = payload_bytes(suffix_len);
+        tracer.probe(entry, (curr - entry) + (lcp_len == m ? payload : 0));
+        if (lcp_len < m) return i + 1;  // entry > string
+        if (lcp_len == m) {  // otherwise, entry < string and m does not change
+            uint64_t k = 0;
+            int cmp = compare_suffix(curr, suffix_len, string.begin + m, string_size - m, &k);
+            if (cmp == 0 and found) *found = true;
+            if (cmp >= 0) return i + 1;
+            m += k;
+        }
+        curr += payload;
+    }
+    return n + 1;
+}
+
+// compare a suffix stored verbatim at p with q, and set lcp to their |lcp|
+inline int compare_plain_suffix(uint8_t const* p, uint64_t suffix_len, uint8_t const* q,
+                                uint64_t q_len, uint64_t* lcp) {
+    uint64_t l = std::min(suffix_len, q_len);
+    uint64_t k = simd::lcp(p, q, l);
+    *lcp = k;
+    if (k != l) return int(p[k]) - int(q[k]);
+    return (suffix_len > q_len) - (suffix_len < q_len);
+}
+
+template <typename Tracer>
+uint64_t front_coded_search(uint8_t const* data, uint64_t n, byte_range string, byte_range header,
+                            Tracer const& tracer, bool* found) {
+    return front_coded_search(data, n, string, header, tracer, found, compare_plain_suffix,
+                              [](uint64_t suffix_len) { return suffix_len; });
+}
@@ -3,10 +3,21 @@
 #include <iterator>
 #include <vector>
 #include <string>
-#include <immintrin.h>  // for __builtin_bswap64
+#include <algorithm>
+#include <cassert>
+
+#include "util.hpp"
+
+/* Lower bound on a sorted sequence of std::string, searching on the integers formed by
+   the first 8 bytes of the strings (zero-padded, as in integer_prefix) first.
+
+   As the integer prefixes are non-decreasing, the strings whose prefix is smaller
+   (resp. larger) than the prefix of the searched string are smaller (resp. larger)
+   than the string itself: the lower bound is in the range of the strings having the
+   same prefix, that is resolved with a (full) string comparison. */
 
 inline uint64_t string_prefix_to_uint64(std::string const& s) {
-    return __builtin_bswap64(*reinterpret_cast<uint64_t const*>(s.data()));
+    return integer_prefix<64>::from(s);
 }
 
 inline bool compare_integer_prefix(std::string const& str, uint64_t prefix) {
@@ -14,51 +25,143 @@ inline bool compare_integer_prefix(std::string const& str, uint64_t prefix) {
     return x < prefix;
 }
 
+// the prefixes are computed on the fly: see integer_prefix_array to store them
 template <typename Iterator>
 Iterator integer_prefix_lower_bound(Iterator first, Iterator last, std::string const& val) {
     uint64_t target_prefix = string_prefix_to_uint64(val);
-    Iterator it;
-    typename std::iterator_traits<Iterator>::difference_type count, step;
-    count = std::distance(first, last);
-
-    /*
-
-        the problem with this approach is that
-        it does not point to the *first* distinct prefix,
-        so then we cannot complete...
-
-    */
-    while (count > 0) {
-        it = first;
-        step = count / 2;
-        std::advance(it, step);
-        bool less = compare_integer_prefix(*it, target_prefix);
-        if (less) {
-            first = ++it;
-            count -= step + 1;
-        } else {
-            count = step;
+    first = std::lower_bound(first, last, target_prefix, compare_integer_prefix);
+    auto greater_prefix = [](uint64_t prefix, std::string const& str) {
+        return prefix < string_prefix_to_uint64(str);
+    };
+    last = std::upper_bound(first, last, target_prefix, greater_prefix);
+    return std::lower_bound(first, last, val);
+}
+
+/* A side array of the integer prefixes of a sorted std::vector<std::string>, stored
+   contiguously (8 bytes per string), so that the first phase of the search touches
+   neither the std::string objects nor their (heap-allocated) bytes.
+   It must be kept in sync with the vector: see prefix_indexed_string_vector. */
+
+struct integer_prefix_array {
+    void build(std::vector<std::string> const& strings) {
+        m_prefixes.resize(strings.size());
+        for (uint64_t i = 0; i != strings.size(); ++i) {
+            m_prefixes[i] = string_prefix_to_uint64(strings[i]);
         }
     }
-    return first;
-
-    // it = first;
-    // uint64_t n = count;
-    // for (uint64_t i = 0; i != n; ++i, ++it) {
-    //     if (*it >= val) return it;
-    // }
-    // return it;
-
-    // while (count > 0) {
-    //     it = first;
-    //     step = count / 2;
-    //     std::advance(it, step);
-    //     if (*it < val) {
-    //         first = ++it;
-    //         count -= step + 1;
-    //     } else {
-    //         count = step;
-    //     }
-    // }
-    // return first;
-}
+
+    uint64_t size() const {
+        return m_prefixes.size();
+    }
+
+    uint64_t lower_bound(std::vector<std::string> const& strings, std::string const& val) const {
+        assert(strings.size() == size());
+        uint64_t target_prefix = string_prefix_to_uint64(val);
+        // branch-free binary search for the first prefix >= target_prefix
+        uint64_t const* base = m_prefixes.data();
+        uint64_t n = size();
+        while (n > 1) {
+            uint64_t half = n / 2;
+            base = base[half] < target_prefix ? base + half : base;
+            n -= half;
+        }
+        uint64_t begin = (base - m_prefixes.data()) + (n == 1 and *base < target_prefix);
+        // the range of equal prefixes is usually short: find its end by exponential search
+        uint64_t lo = begin, step = 1;
+        while (lo + step < size() and m_prefixes[lo + step] == target_prefix) {
+            lo += step;
+            step *= 2;
+        }
+        uint64_t end = std::upper_bound(m_prefixes.begin() + lo,
+                                        m_prefixes.begin() + std::min(lo + step, size()),
+                                        target_prefix) -
+                       m_prefixes.begin();
+        return std::lower_bound(strings.begin() + begin, strings.begin() + end, val) -
+               strings.begin();
+    }
+
+    void insert(uint64_t i, std::string const& string) {
+        m_prefixes.insert(m_prefixes.begin() + i, string_prefix_to_uint64(string));
+    }
+
+    void erase(uint64_t i) {
+        m_prefixes.erase(m_prefixes.begin() + i);
+    }
+
+    void clear() {
+        m_prefixes.clear();
+    }
+
+    uint64_t bytes() const {
+        return m_prefixes.size() * sizeof(m_prefixes.front());
+    }
+
+private:
+    std::vector<uint64_t> m_prefixes;
+};
+
+/* A sorted std::vector<std::string> (without duplicates) with its integer_prefix_array,
+   updated together. The vector is exposed read-only, for the code that needs it. */
+
+struct prefix_indexed_string_vector {
+    prefix_indexed_string_vector() {}
+
+    // the strings must be sorted and distinct
+    prefix_indexed_string_vector(std::vector<std::string> strings)
+        : m_strings(std::move(strings)) {
+        assert(std::is_sorted(m_strings.begin(), m_strings.end()));
+        m_prefixes.build(m_strings);
+    }
+
+    std::vector<std::string> const& strings() const {
+        return m_strings;
+    }
+
+    uint64_t size() const {
+        return m_strings.size();
+    }
+
+    std::string const& operator[](uint64_t i) const {
+        assert(i < size());
+        return m_strings[i];
+    }
+
+    uint64_t lower_bound(std::string const& val) const {
+        return m_prefixes.lower_bound(m_strings, val);
+    }
+
+    uint64_t lookup(std::string const& val) const {
+        uint64_t i = lower_bound(val);
+        return i != size() and m_strings[i] == val ? i : constants::invalid_id;
+    }
+
+    // insert the string (if not present) and return its position
+    uint64_t insert(std::string const& string) {
+        uint64_t i = lower_bound(string);
+        if (i == size() or m_strings[i] != string) {
+            m_strings.insert(m_strings.begin() + i, string);
+            m_prefixes.insert(i, string);
+        }
+        return i;
+    }
+
+    void erase(uint64_t i) {
+        assert(i < size());
+        m_strings.erase(m_strings.begin() + i);
+        m_prefixes.erase(i);
+    }
+
+    void clear() {
+        m_strings.clear();
+        m_prefixes.clear();
+    }
+
+    // the space of the side array (the strings take the same space as in a plain vector)
+    uint64_t bytes() const {
+        return m_prefixes.bytes();
+    }
+
+private:
+    std::vector<std::string> m_strings;
+    integer_prefix_array m_prefixes;
+};
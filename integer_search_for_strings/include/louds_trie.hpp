@@ -0,0 +1,319 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cassert>
+#include <algorithm>
+
+#include "util.hpp"
+#include "string_pool.hpp"
+#include "bit_vector.hpp"
+#include "symbol_table.hpp"
+
+/* A path-compressed trie over a sorted collection of distinct strings, whose topology is
+   encoded with LOUDS [Jacobson, FOCS 1989], mapping each string to its rank
+   (i.e., the same ID assigned by string_pool).
+
+   - Nodes are numbered in BFS order. The LOUDS bit vector is 10 (for a super root)
+     followed by 1^d 0 for each node of degree d, so that the children of a node are
+     consecutive and the first one is found with a select0 and a rank1.
+   - The label of the edge leading to a node is split into its first byte (one byte per node,
+     searched among the siblings) and its remaining bytes (the tail), that are concatenated
+     in a byte array. The root only has a tail (the common prefix of all strings).
+   - Every node stores the ID of the first string of its subtree (and a bit telling whether
+     the path to the node is a string, whose ID is such first one): this gives the ranks
+     for lookup and lower_bound, and drives the descent in access.
+   - The ends of the tails and the IDs are bit-packed into compact_vectors.
+   - With suffix_codec::fsst, the tails are compressed with a symbol_table
+     and matched against the query without decoding them. */
+
+struct louds_trie {
+    struct builder {
+        builder(suffix_codec codec = suffix_codec::plain)
+            : m_size(0), m_max_string_length(0), m_codec(codec) {}
+
+        template <typename Iterator>
+        void build(Iterator begin, uint64_t n) {
+            string_pool::builder pool_builder(n);
+            pool_builder.build(begin, n);
+            string_pool pool;
+            pool_builder.build(pool);
+
+            m_size = n;
+            bit_vector::builder louds;
+            louds.push_back(1);  // super root
+            louds.push_back(0);
+            bit_vector::builder values;
+            std::vector<uint64_t> begins;
+            std::vector<uint64_t> tail_ends;
+
+            struct node {
+                uint64_t lo, hi;  // the strings of the subtree
+                uint64_t depth;   // length of the path to the parent node
+            };
+            std::vector<node> queue;
+            if (n) queue.push_back({0, n, 0});
+            for (uint64_t head = 0; head != queue.size(); ++head) {
+                node x = queue[head];
+                byte_range first = pool.access(x.lo);
+                byte_range last = pool.access(x.hi - 1);
+                uint64_t first_size = first.end - first.begin;
+                uint64_t last_size = last.end - last.begin;
+                m_max_string_length = std::max(m_max_string_length, last_size);
+                uint64_t lcp = x.depth + simd::lcp(first.begin + x.depth, last.begin + x.depth,
+                                                   std::min(first_size, last_size) - x.depth);
+                bool has_value = first_size == lcp;
+                bool is_root = head == 0;
+                assert(is_root or lcp > x.depth);
+                m_first_bytes.push_back(is_root ? 0 : first.begin[x.depth]);
+                m_tails.insert(m_tails.end(), first.begin + x.depth + !is_root, first.begin + lcp);
+                tail_ends.push_back(m_tails.size());
+                values.push_back(has_value);
+                begins.push_back(x.lo);
+
+                // partition the remaining strings by their byte at position lcp
+                for (uint64_t i = x.lo + has_value; i != x.hi;) {
+                    uint8_t c = pool.access(i).begin[lcp];
+                    uint64_t j = i + 1;
+                    while (j != x.hi and pool.access(j).begin[lcp] == c) ++j;
+                    queue.push_back({i, j, lcp});
+                    louds.push_back(1);
+                    i = j;
+                }
+                louds.push_back(0);
+            }
+            std::vector<node>().swap(queue);
+            if (m_codec == suffix_codec::fsst) compress_tails(tail_ends);
+
+            uint64_t num_nodes = begins.size();
+            louds.build(m_louds);
+            values.build(m_values);
+            compact_vector::builder begins_builder(num_nodes, compact_vector::width(n));
+            compact_vector::builder tails_builder(num_nodes, compact_vector::width(m_tails.size()));
+            for (uint64_t v = 0; v != num_nodes; ++v) {
+                begins_builder.set(v, begins[v]);
+                tails_builder.set(v, tail_ends[v]);
+            }
+            begins_builder.build(m_begins);
+            tails_builder.build(m_tail_ends);
+
+            std::cout << "num. nodes: " << num_nodes << "; tail bytes: " << m_tails.size()
+                      << std::endl;
+        }
+
+        void build(louds_trie& trie) {
+            trie.m_size = m_size;
+            trie.m_max_string_length = m_max_string_length;
+            trie.m_codec = m_codec;
+            std::swap(trie.m_table, m_table);
+            std::swap(trie.m_louds, m_louds);
+            std::swap(trie.m_values, m_values);
+            std::swap(trie.m_begins, m_begins);
+            std::swap(trie.m_tail_ends, m_tail_ends);
+            trie.m_first_bytes.swap(m_first_bytes);
+            trie.m_tails.swap(m_tails);
+            builder(m_codec).swap(*this);
+        }
+
+        void swap(builder& other) {
+            std::swap(other.m_size, m_size);
+            std::swap(other.m_max_string_length, m_max_string_length);
+            std::swap(other.m_codec, m_codec);
+            std::swap(other.m_table, m_table);
+            std::swap(other.m_louds, m_louds);
+            std::swap(other.m_values, m_values);
+            std::swap(other.m_begins, m_begins);
+            std::swap(other.m_tail_ends, m_tail_ends);
+            other.m_first_bytes.swap(m_first_bytes);
+            other.m_tails.swap(m_tails);
+        }
+
+    private:
+        uint64_t m_size;
+        uint64_t m_max_string_length;
+        suffix_codec m_codec;
+        symbol_table m_table;
+        bit_vector m_louds;
+        bit_vector m_values;
+        compact_vector m_begins;
+        compact_vector m_tail_ends;
+        std::vector<uint8_t> m_first_bytes;
+        std::vector<uint8_t> m_tails;
+
+        // learn the symbol table from (at most max_sample_size) tails and encode all of them
+        void compress_tails(std::vector<uint64_t>& tail_ends) {
+            static const uint64_t max_sample_size = uint64_t(1) << 14;
+            uint64_t num_nodes = tail_ends.size();
+            uint64_t step = std::max<uint64_t>(1, num_nodes / max_sample_size);
+            std::vector<std::string> sample;
+            for (uint64_t v = 0; v < num_nodes; v += step) {
+                uint64_t begin = v ? tail_ends[v - 1] : 0;
+                if (begin != tail_ends[v]) {
+                    sample.emplace_back(m_tails.begin() + begin, m_tails.begin() + tail_ends[v]);
+                }
+            }
+            m_table.build(sample);
+            std::vector<uint8_t> codes;
+            uint8_t const* begin = m_tails.data();
+            for (uint64_t v = 0; v != num_nodes; ++v) {
+                uint8_t const* end = m_tails.data() + tail_ends[v];
+                m_table.encode({begin, end}, codes);
+                tail_ends[v] = codes.size();
+                begin = end;
+            }
+            std::cout << "num. symbols " << m_table.size() << "; compressed tails from "
+                      << m_tails.size() << " to " << codes.size() << " bytes" << std::endl;
+            m_tails.swap(codes);
+        }
+    };
+
+    louds_trie() : m_size(0), m_max_string_length(0), m_codec(suffix_codec::plain) {}
+
+    uint64_t size() const {
+        return m_size;
+    }
+
+    /* The output buffer of access(id, string) must hold at least these many bytes,
+       plus symbol_table::slack if the codec is suffix_codec::fsst. */
+    uint64_t max_string_length() const {
+        return m_max_string_length;
+    }
+
+    uint64_t lookup(byte_range string) const {
+        if (size() == 0) return constants::invalid_id;
+        uint64_t size = string.end - string.begin;
+        uint64_t depth = 0;
+        uint64_t v = 0;
+        while (true) {
+            uint64_t l = 0;
+            if (compare_tail(v, {string.begin + depth, string.end}, &l) != 0) {
+                return constants::invalid_id;
+            }
+            depth += l;
+            if (depth == size) return m_values[v] ? m_begins[v] : constants::invalid_id;
+            auto [first, last] = children(v);
+            uint64_t c = find_child(first, last, string.begin[depth]);
+            if (c == last or m_first_bytes[c] != string.begin[depth]) {
+                return constants::invalid_id;
+            }
+            v = c;
+            depth += 1;
+        }
+    }
+
+    uint64_t lower_bound(byte_range string) const {
+        if (size() == 0) return 0;
+        uint64_t size = string.end - string.begin;
+        uint64_t depth = 0;
+        uint64_t v = 0;
+        uint64_t end = m_size;  // end of the IDs of the subtree of v
+        while (true) {
+            uint64_t l = 0;
+            int cmp = compare_tail(v, {string.begin + depth, string.end}, &l);
+            if (cmp < 0) return end;
+            if (cmp > 0) return m_begins[v];  // also if string is a prefix of the path
+            depth += l;
+            if (depth == size) return m_begins[v];
+            uint8_t b = string.begin[depth];
+            auto [first, last] = children(v);
+            uint64_t c = find_child(first, last, b);
+            if (c == last) return end;
+            if (m_first_bytes[c] != b) return m_begins[c];
+            if (c + 1 != last) end = m_begins[c + 1];
+            v = c;
+            depth += 1;
+        }
+    }
+
+    uint64_t lower_bound(std::string const& string) const {
+        return lower_bound(byte_range_from_string(string));
+    }
+
+    uint64_t access(uint64_t id, uint8_t* string) const {
+        assert(id < size());
+        uint64_t size = 0;
+        uint64_t v = 0;
+        while (true) {
+            if (v) string[size++] = m_first_bytes[v];
+            byte_range t = tail(v);
+            if (m_codec == suffix_codec::fsst) {
+                size = m_table.decode(t.begin, t.end, string + size) - string;
+            } else {
+                std::copy(t.begin, t.end, string + size);
+                size += t.end - t.begin;
+            }
+            if (m_begins[v] == id and m_values[v]) return size;
+            // the last child whose first ID is <= id
+            auto [first, last] = children(v);
+            assert(last > first);
+            while (last - first > 1) {
+                uint64_t mid = (first + last) / 2;
+                if (m_begins[mid] <= id) {
+                    first = mid;
+                } else {
+                    last = mid;
+                }
+            }
+            v = first;
+        }
+    }
+
+    std::string access(uint64_t id) const {
+        std::string string;
+        string.resize(m_max_string_length + symbol_table::slack);
+        uint64_t size = access(id, reinterpret_cast<uint8_t*>(string.data()));
+        string.resize(size);
+        return string;
+    }
+
+    uint64_t bytes() const {
+        return m_louds.bytes() + m_values.bytes() + m_begins.bytes() + m_tail_ends.bytes() +
+               m_first_bytes.size() * sizeof(m_first_bytes.front()) +
+               m_tails.size() * sizeof(m_tails.front()) +
+               (m_codec == suffix_codec::fsst ? m_table.bytes() : 0);
+    }
+
+private:
+    uint64_t m_size;
+    uint64_t m_max_string_length;
+    suffix_codec m_codec;
+    symbol_table m_table;
+    bit_vector m_louds;
+    bit_vector m_values;
+    compact_vector m_begins;
+    compact_vector m_tail_ends;
+    std::vector<uint8_t> m_first_bytes;
+    std::vector<uint8_t> m_tails;
+
+    byte_range tail(uint64_t v) const {
+        uint64_t begin = v ? m_tail_ends[v - 1] : 0;
+        uint64_t end = m_tail_ends[v];
+        return {m_tails.data() + begin, m_tails.data() + end};
+    }
+
+    /* Compare the tail t of v with the prefix of q of length |t| (as symbol_table::compare_prefix):
+       the result is 0 if t is a prefix of q and lcp is set to |lcp(t, q)|. */
+    int compare_tail(uint64_t v, byte_range q, uint64_t* lcp) const {
+        byte_range t = tail(v);
+        if (m_codec == suffix_codec::fsst) return m_table.compare_prefix(t.begin, t.end, q, lcp);
+        uint64_t l = t.end - t.begin;
+        uint64_t m = std::min<uint64_t>(l, q.end - q.begin);
+        uint64_t k = simd::lcp(t.begin, q.begin, m);
+        *lcp = k;
+        if (k != m) return int(t.begin[k]) - int(q.begin[k]);
+        return k != l;  // q is a proper prefix of t
+    }
+
+    // the children of v are the nodes [first, last)
+    std::pair<uint64_t, uint64_t> children(uint64_t v) const {
+        uint64_t p = m_louds.select0(v) + 1;
+        uint64_t first = m_louds.rank1(p);
+        return {first, first + m_louds.next0(p) - p};
+    }
+
+    // the first child (in [first, last)) whose first byte is >= b
+    uint64_t find_child(uint64_t first, uint64_t last, uint8_t b) const {
+        auto begin = m_first_bytes.begin();
+        return std::lower_bound(begin + first, begin + last, b) - begin;
+    }
+};
@@ -5,19 +5,26 @@
 #include <cmath>
 
 #include "util.hpp"
+#include "front_coding.hpp"
 #include "prefix_indexed_string_pool.hpp"
+#include "tracing.hpp"
 
-template <uint64_t BucketSize>
+/* Same as front_coded_dictionary, but the headers are searched
+   with a prefix_indexed_string_pool (that reports its probes to the same Tracer). */
+
+template <uint64_t BucketSize, typename Tracer = no_tracer>
 struct prefix_indexed_front_coded_dictionary {
+    typedef prefix_indexed_string_pool<64, false, 32, Tracer> pool_type;
+
     struct builder {
-        builder() {}
+        builder() : m_size(0), m_max_string_length(0) {}
 
         template <typename Iterator>
         void build(Iterator begin, uint64_t n) {
             m_size = n;
             uint64_t buckets = std::ceil(static_cast<double>(n) / (BucketSize + 1));
-            uint64_t tail = n - ((n / (BucketSize + 1)) * (BucketSize + 1));
-            if (tail) tail -= 1;  // remove header
+            uint64_t tail = n % (BucketSize + 1);
+            tail = tail ? tail - 1 : BucketSize;  // remove header
 
             std::cout << "n " << n << std::endl;
             std::cout << "buckets " << buckets << std::endl;
@@ -28,18 +35,18 @@ struct prefix_indexed_front_coded_dictionary {
             std::string prev, curr, header;
             for (uint64_t b = 0; b != buckets; ++b) {
                 header = *begin++;
+                m_max_string_length = std::max<uint64_t>(m_max_string_length, header.size());
                 headers.push_back(header);
                 prev.swap(header);
                 uint64_t size = b != buckets - 1 ? BucketSize : tail;
                 for (uint64_t i = 0; i != size; ++i) {
                     curr = *begin++;
-                    uint64_t l = 0;  // |lcp(curr,prev)|
-                    while (l != curr.size() and l != prev.size() and curr[l] == prev[l]) { ++l; }
-                    assert(l < 256);
-                    m_data.push_back(l);
+                    uint64_t l = string_lcp(curr, prev);
                     uint64_t size = curr.size();
                     assert(size >= l);
-                    m_data.push_back(size - l);
+                    m_max_string_length = std::max(m_max_string_length, size);
+                    write_varint(m_data, l);
+                    write_varint(m_data, size - l);
                     m_data.insert(m_data.end(), curr.begin() + l, curr.end());
                     prev.swap(curr);
                 }
@@ -52,11 +59,6 @@ struct prefix_indexed_front_coded_dictionary {
                 m_buckets_offsets.push_back(m_data.size());
             }
 
-            // NOTE: pad to allow fixed-copy operations
-            for (uint64_t i = 0; i != constants::max_string_length - 1; ++i) {
-                m_data.push_back(0);
-            }
-
             std::cout << "DONE" << std::endl;
 
             std::cout << "headers.size() " << headers.size() << std::endl;
@@ -64,6 +66,7 @@ struct prefix_indexed_front_coded_dictionary {
 
         void swap(builder& other) {
             std::swap(other.m_size, m_size);
+            std::swap(other.m_max_string_length, m_max_string_length);
             other.headers.swap(headers);
             other.m_buckets_offsets.swap(m_buckets_offsets);
             other.m_data.swap(m_data);
@@ -71,8 +74,9 @@ struct prefix_indexed_front_coded_dictionary {
 
         void build(prefix_indexed_front_coded_dictionary& dict) {
             dict.m_size = m_size;
+            dict.m_max_string_length = m_max_string_length;
 
-            prefix_indexed_string_pool::builder prefixes_builder(headers.size());
+            typename pool_type::builder prefixes_builder(headers.size());
             prefixes_builder.build(headers.begin(), headers.size());
             prefixes_builder.build(dict.m_pool);
 
@@ -83,6 +87,7 @@ struct prefix_indexed_front_coded_dictionary {
 
     private:
         uint64_t m_size;
+        uint64_t m_max_string_length;
         std::vector<std::string> headers;
         std::vector<uint32_t> m_buckets_offsets;
         std::vector<uint8_t> m_data;
@@ -91,6 +96,7 @@ struct prefix_indexed_front_coded_dictionary {
     template <typename Visitor>
     void visit(Visitor& visitor) {
         visitor.visit(m_size);
+        visitor.visit(m_max_string_length);
         visitor.visit(m_pool);
         visitor.visit(m_buckets_offsets);
         visitor.visit(m_data);
@@ -100,15 +106,27 @@ struct prefix_indexed_front_coded_dictionary {
         return m_size;
     }
 
+    // the output buffer of access(id, string) must hold at least these many bytes
+    uint64_t max_string_length() const {
+        return m_max_string_length;
+    }
+
+    void set_tracer(Tracer tracer) {
+        m_tracer = tracer;
+        m_pool.set_tracer(tracer);
+    }
+
+    Tracer const& tracer() const {
+        return m_tracer;
+    }
+
     uint64_t lookup(byte_range string) const {
         auto [header, string_is_header, bucket] = locate_bucket(string);
         uint64_t base = bucket * (BucketSize + 1);
         if (string_is_header) return base;
+        if (bucket == 0 and byte_range_compare(header, string) > 0) return constants::invalid_id;
         uint64_t offset = lookup(string, header, bucket);
-        if (offset == constants::invalid_id) {
-            assert(false);
-            return constants::invalid_id;
-        }
+        if (offset == constants::invalid_id) return constants::invalid_id;
         return base + offset;
     }
 
@@ -116,9 +134,8 @@ struct prefix_indexed_front_coded_dictionary {
         auto [header, string_is_header, bucket] = locate_bucket(string);
         uint64_t base = bucket * (BucketSize + 1);
         if (string_is_header) return base;
-        uint64_t offset = lower_bound(string, header, bucket);
-        if (offset == constants::invalid_id) return constants::invalid_id;
-        return base + offset;
+        if (bucket == 0 and byte_range_compare(header, string) > 0) return 0;
+        return base + lower_bound(string, header, bucket);
     }
 
     uint64_t access(uint64_t id, uint8_t* string) const {
@@ -130,15 +147,22 @@ struct prefix_indexed_front_coded_dictionary {
 
     std::string access(uint64_t id) const {
         std::string string;
-        string.resize(2 * constants::max_string_length);
+        string.resize(m_max_string_length);
         uint64_t size = access(id, reinterpret_cast<uint8_t*>(string.data()));
         string.resize(size);
         return string;
     }
 
+    uint64_t bytes() const {
+        return m_pool.bytes() + m_buckets_offsets.size() * sizeof(m_buckets_offsets.front()) +
+               m_data.size() * sizeof(m_data.front());
+    }
+
 private:
     uint64_t m_size;
-    prefix_indexed_string_pool m_pool;
+    uint64_t m_max_string_length;
+    pool_type m_pool;
+    Tracer m_tracer;
     std::vector<uint32_t> m_buckets_offsets;
     std::vector<uint8_t> m_data;
 
@@ -148,9 +172,8 @@ private:
 
     uint64_t bucket_size(uint64_t bucket) const {
         if (bucket != buckets() - 1) return BucketSize;
-        uint64_t tail = size() - ((size() / (BucketSize + 1)) * (BucketSize + 1));
-        if (tail) tail -= 1;
-        return tail;
+        uint64_t tail = size() % (BucketSize + 1);
+        return tail ? tail - 1 : BucketSize;
     }
 
     std::tuple<byte_range, bool, int> locate_bucket(byte_range string) const {
@@ -162,68 +185,56 @@ private:
             last = true;
         }
         auto header = m_pool.access(p);
+        m_tracer.probe(header.begin, header.end - header.begin);
         // std::cout << "header '" << string_from_byte_range(header) << "'" << std::endl;
         if (byte_range_compare(header, string) == 0) return {header, true, p};
 
         if (p > 0 and !last) p -= 1;
         header = m_pool.access(p);
+        m_tracer.probe(header.begin, header.end - header.begin);
 
         // std::cout << "header '" << string_from_byte_range(header) << "'" << std::endl;
         // std::cout << "string '" << string_from_byte_range(string) << "'" << std::endl;
-        assert(byte_range_compare(header, string) <= 0);
+        assert(p == 0 or byte_range_compare(header, string) <= 0);
         return {header, byte_range_compare(header, string) == 0, p};
     }
 
-    uint8_t decode(uint8_t const* in, uint8_t* out, uint8_t* lcp_len) const {
-        *lcp_len = *in++;
-        uint8_t l = *lcp_len;
-        uint8_t suffix_len = *in++;
-        memcpy(out + l, in, constants::max_string_length);
-        return l + suffix_len;
+    /* Decode the entry pointed to by in, given the previous string in out,
+       and return the size of the decoded string. The pointer in is moved to the next entry. */
+    uint64_t decode(uint8_t const*& in, uint8_t* out) const {
+        uint64_t lcp_len = read_varint(in);
+        uint64_t suffix_len = read_varint(in);
+        memcpy(out + lcp_len, in, suffix_len);
+        in += suffix_len;
+        return lcp_len + suffix_len;
+    }
+
+    /* Return the position, within the bucket, of the first string that is >= string
+       (the header being at position 0). If found is not null, it is set to true if such
+       string is equal to string. Requires header < string. */
+    uint64_t search(byte_range string, byte_range header, uint64_t bucket, bool* found) const {
+        m_tracer.probe(&m_buckets_offsets[bucket], sizeof(uint32_t));
+        return front_coded_search(m_data.data() + m_buckets_offsets[bucket], bucket_size(bucket),
+                                  string, header, m_tracer, found);
     }
 
     uint64_t lower_bound(byte_range string, byte_range header, uint64_t bucket) const {
-        static uint8_t decoded[2 * constants::max_string_length];
-        memcpy(decoded, header.begin, constants::max_string_length);
-        uint64_t n = bucket_size(bucket);
-        uint8_t lcp_len;
-        uint8_t const* curr = m_data.data() + m_buckets_offsets[bucket];
-        for (uint64_t i = 0; i != n; ++i) {
-            uint8_t l = decode(curr, decoded, &lcp_len);
-            int cmp = byte_range_compare(string, {decoded, decoded + l});
-            if (cmp <= 0) return i + 1;
-            curr += l - lcp_len + 2;
-        }
-        return constants::invalid_id;
+        return search(string, header, bucket, nullptr);
     }
 
     uint64_t lookup(byte_range string, byte_range header, uint64_t bucket) const {
-        static uint8_t decoded[2 * constants::max_string_length];
-        memcpy(decoded, header.begin, constants::max_string_length);
-        uint64_t n = bucket_size(bucket);
-        uint8_t lcp_len;
-        uint8_t const* curr = m_data.data() + m_buckets_offsets[bucket];
-        for (uint64_t i = 0; i != n; ++i) {
-            uint8_t l = decode(curr, decoded, &lcp_len);
-            int cmp = byte_range_compare(string, {decoded, decoded + l});
-            if (cmp == 0) return i + 1;
-            if (cmp < 0) return constants::invalid_id;
-            curr += l - lcp_len + 2;
-        }
-        return constants::invalid_id;
+        bool found = false;
+        uint64_t i = search(string, header, bucket, &found);
+        return found ? i : constants::invalid_id;
     }
 
     uint64_t access(uint64_t bucket, uint64_t id, uint8_t* string) const {
         assert(id <= bucket_size(bucket));
         byte_range header = m_pool.access(bucket);
-        memcpy(string, header.begin, constants::max_string_length);
-        uint8_t lcp_len;
-        uint8_t const* curr = m_data.data() + m_buckets_offsets[bucket];
         uint64_t size = header.end - header.begin;
-        for (uint64_t i = 1; i <= id; ++i) {
-            size = decode(curr, string, &lcp_len);
-            curr += size - lcp_len + 2;
-        }
+        memcpy(string, header.begin, size);
+        uint8_t const* curr = m_data.data() + m_buckets_offsets[bucket];
+        for (uint64_t i = 1; i <= id; ++i) size = decode(curr, string);
         return size;
     }
 };
\ No newline at end of file
@@ -6,13 +6,30 @@
 #include <algorithm>
 
 #include "util.hpp"
-
-/* A pool of strings indexed by their integer prefixes of size (at most) 8. */
-
+#include "radix_jump_table.hpp"
+#include "tracing.hpp"
+
+/* A pool of strings indexed by their integer prefixes of PrefixBits/8 bytes
+   (strings that are shorter are padded with zeros).
+
+   - PrefixBits is 32, 64 or 128. Prefixes of 128 bits are compared with SIMD instructions.
+   - A prefix is sampled when it differs from the previously sampled one and
+     more than SamplingConstant strings have been seen since then.
+   - If StripPrefix is true, every distinct prefix is sampled (hence SamplingConstant must be 0)
+     and only the string suffixes following the prefix are stored, so that common prefixes are
+     stored once. In this case, access(i) returns the suffix of the i-th string and strings must
+     not contain the '\0' byte (that is used as padding).
+   - The probes of lower_bound(val) are reported to a Tracer (see tracing.hpp).
+*/
+
+template <uint32_t PrefixBits = 64, bool StripPrefix = false, uint64_t SamplingConstant = 32,
+          typename Tracer = no_tracer>
 struct prefix_indexed_string_pool {
     typedef uint32_t pointer_type;
-    typedef uint64_t prefix_type;
-    static const uint32_t bits = sizeof(prefix_type) * 8;
+    typedef integer_prefix<PrefixBits> prefix;
+    typedef typename prefix::type prefix_type;
+    static_assert(!StripPrefix or SamplingConstant == 0,
+                  "stripping prefixes requires that all distinct prefixes are sampled");
 
     struct builder {
         builder(uint64_t num_strings = 0) {
@@ -23,23 +40,28 @@ struct prefix_indexed_string_pool {
         template <typename Iterator>
         void build(Iterator begin, uint64_t n) {
             for (uint64_t i = 0; i != n; ++i, ++begin) {
-                auto str = *begin;
-                append(byte_range_from_string(str));
+                auto const& str = *begin;
+                auto br = byte_range_from_string(str);
+                if constexpr (StripPrefix) {
+                    assert(std::find(str.begin(), str.end(), '\0') == str.end());
+                    append(suffix(br));
+                } else {
+                    append(br);
+                }
                 if (m_strings.size() > (uint64_t(1) << (sizeof(pointer_type) * 8))) {
                     throw std::runtime_error(std::to_string(sizeof(pointer_type) * 8) +
                                              " bits per pointers are not enough");
                 }
 
                 // keep only distinct integer prefixes
-                prefix_type x = string_to_uint<bits>(str);
+                prefix_type x = prefix::from(br);
                 if (m_prefixes.empty()) {
                     m_pointers.push_back(0);
                     m_prefixes.push_back(x);
                     continue;
                 }
 
-                static const uint64_t C = 32;
-                if (m_prefixes.back() != x and i - m_pointers.back() > C) {
+                if (m_prefixes.back() != x and i - m_pointers.back() > SamplingConstant) {
                     m_pointers.push_back(i);
                     m_prefixes.push_back(x);
                 }
@@ -48,8 +70,8 @@ struct prefix_indexed_string_pool {
 
             std::cout << "num. prefixes: " << m_prefixes.size() << " ("
                       << (m_prefixes.size() * 100.0) / n << "%)" << std::endl;
-            assert(std::unique(m_prefixes.begin(), m_prefixes.end()) == m_prefixes.end());
             assert(std::is_sorted(m_prefixes.begin(), m_prefixes.end()));
+            assert(std::adjacent_find(m_prefixes.begin(), m_prefixes.end()) == m_prefixes.end());
         }
 
         void append(byte_range br) {
@@ -95,108 +117,60 @@ struct prefix_indexed_string_pool {
 
     uint64_t lower_bound(std::string const& val) const {
         return lower_bound(byte_range_from_string(val));
+    }
 
-        // This first search is 5X faster than the overall process,
-        // so we should not spend time in making it faster.
-        // We should, instead, devise a faster solution to search
-        // through a (medium-short) range of strings,
-        // which is the step performed after this search.
-        prefix_type x = string_to_uint<bits>(val);
-        auto it = std::lower_bound(m_prefixes.begin(), m_prefixes.end(), x);
-        uint64_t p = std::distance(m_prefixes.begin(), it);
-        uint64_t begin = m_pointers[p ? p - 1 : p];
-        uint64_t end = m_pointers[p == m_prefixes.size() ? p : p + 1];
-        assert(end > begin);
-        int64_t count = end - begin;
-
-        /*
-            With this, we improve by 3X, thus indicating that we should optimize
-            for small ranges. Build a small trie on the range?
-        */
-        // if (count <= 256) return count;
-
-        /*
-            Maybe we could re-use the same technique inside the range, essentially
-            making a two/three-level data structure.
-        */
-
-        // option 1. small ranges are done via linear search
-        // if (count < 256) {
-        //     auto target = byte_range_from_string(val);
-        //     while (byte_range_compare_v2(access(begin), target)) ++begin;
-        //     return begin;
-        // }
-
-        // option 2. always do binary search
-        // this seems to be the fastest option...
-        int64_t step = 0;
-        uint64_t i = begin;
-        uint64_t ret = begin;
-        auto target = byte_range_from_string(val);
-        while (count > 0) {
-            i = ret;
-            step = count / 2;
-            i += step;
-
-            /* this is faster than traditional string compare as below */
-            bool less = byte_range_compare_v2(access(i), target);
-            // bool less = byte_range_compare(access(i), target) < 0;
+    void set_tracer(Tracer tracer) {
+        m_tracer = tracer;
+    }
 
-            if (less) {
-                ret = ++i;
-                count -= step + 1;
-            } else {
-                count = step;
-            }
-        }
-        return ret;
+    Tracer const& tracer() const {
+        return m_tracer;
+    }
 
-        // option 3. cutoff to linear search
-        // int64_t step = 0;
-        // uint64_t i = begin;
-        // uint64_t ret = begin;
-        // auto target = byte_range_from_string(val);
-        // while (count > 128) {
-        //     i = ret;
-        //     step = count / 2;
-        //     i += step;
-        //     bool less = byte_range_compare_v2(access(i), target);
-        //     if (less) {
-        //         ret = ++i;
-        //         count -= step + 1;
-        //     } else {
-        //         count = step;
-        //     }
-        // }
-        // while (byte_range_compare_v2(access(ret), target)) ++ret;
-        // return ret;
+    /*
+        The search on the prefixes is much faster than the overall process,
+        so it is not worth making it faster: most of the time is spent
+        in searching through the (medium-short) range of strings that follows.
+        Always doing binary search on that range seems to be the fastest option,
+        compared to a linear search or a cutoff to linear search for small ranges.
+    */
+    // optional: restrict the search on the prefixes with a radix_jump_table
+    void build_jump_table() {
+        m_jump_table.build(m_prefixes.size(),
+                           [&](uint64_t i) { return prefix::first_two_bytes(m_prefixes[i]); });
     }
 
     uint64_t lower_bound(byte_range val) const {
-        prefix_type x = byte_range_to_uint<bits>(val);
-        auto it = std::lower_bound(m_prefixes.begin(), m_prefixes.end(), x);
+        prefix_type x = prefix::from(val);
+        auto first = m_prefixes.begin();
+        auto last = m_prefixes.end();
+        if (!m_jump_table.empty()) {
+            auto [begin, end] = m_jump_table.range(prefix::first_two_bytes(x), m_tracer);
+            last = first + end;
+            first += begin;
+        }
+        auto it = std::lower_bound(first, last, x, [&](prefix_type const& l, prefix_type const& r) {
+            m_tracer.probe(&l, sizeof(l));
+            return l < r;
+        });
         uint64_t p = std::distance(m_prefixes.begin(), it);
+
+        if constexpr (StripPrefix) {
+            // all strings having prefix x (if any) are in [m_pointers[p], m_pointers[p + 1])
+            m_tracer.probe(&m_pointers[p], 2 * sizeof(pointer_type));
+            if (p == m_prefixes.size() or m_prefixes[p] != x) return m_pointers[p];
+            return search(m_pointers[p], m_pointers[p + 1], suffix(val),
+                          [](byte_range l, byte_range r) { return byte_range_compare(l, r) < 0; });
+        }
+
+        /* A sampled string is not necessarily the first one having its prefix,
+           but the strings before m_pointers[p - 1] are smaller than val and
+           the string at m_pointers[p + 1] is larger than val. */
         uint64_t begin = m_pointers[p ? p - 1 : p];
         uint64_t end = m_pointers[p == m_prefixes.size() ? p : p + 1];
+        m_tracer.probe(&m_pointers[p ? p - 1 : p], 3 * sizeof(pointer_type));
         assert(end > begin);
-        int64_t count = end - begin;
-        int64_t step = 0;
-        uint64_t i = begin;
-        uint64_t ret = begin;
-        while (count > 0) {
-            i = ret;
-            step = count / 2;
-            i += step;
-            bool less = byte_range_compare_v2(access(i), val);
-            if (less) {
-                ret = ++i;
-                count -= step + 1;
-            } else {
-                count = step;
-            }
-        }
-        assert(ret <= size());
-        return ret;
+        return search(begin, end, val, byte_range_compare_v2);
     }
 
     uint64_t lower_bound(
@@ -204,22 +178,14 @@ struct prefix_indexed_string_pool {
             strings,  // WARNING: this should be the same collection that was used to build the
                       // prefixes. It is passed here as input parameter just for testing.
         std::string const& val) const {
-        prefix_type x = string_to_uint<bits>(val);
+        static_assert(!StripPrefix);
+        prefix_type x = prefix::from(val);
         auto it = std::lower_bound(m_prefixes.begin(), m_prefixes.end(), x);
         uint64_t p = std::distance(m_prefixes.begin(), it);
         uint64_t begin = m_pointers[p ? p - 1 : p];
         uint64_t end = m_pointers[p == m_prefixes.size() ? p : p + 1];
         assert(end > begin);
         int64_t count = end - begin;
-        // return count;
-
-        // if (count < 128) {
-        //     for (uint64_t i = begin; i != end; ++i) {
-        //         if (strings[i] >= val) return i;
-        //     }
-        //     return end;
-        // }
-
         int64_t step = 0;
         uint64_t i = begin;
         uint64_t ret = begin;
@@ -227,7 +193,6 @@ struct prefix_indexed_string_pool {
             i = ret;
             step = count / 2;
             i += step;
-            // bool less = strings[i] < val;
             bool less = string_compare_v2(strings[i], val);
             if (less) {
                 ret = ++i;
@@ -243,7 +208,7 @@ struct prefix_indexed_string_pool {
         return m_prefixes.size() * sizeof(m_prefixes.front()) +
                m_pointers.size() * sizeof(m_pointers.front()) +
                m_strings_offsets.size() * sizeof(m_strings_offsets.front()) +
-               m_strings.size() * sizeof(m_strings.front());
+               m_strings.size() * sizeof(m_strings.front()) + m_jump_table.bytes();
     }
 
 private:
@@ -251,4 +216,36 @@ private:
     std::vector<pointer_type> m_pointers;
     std::vector<pointer_type> m_strings_offsets;
     std::vector<uint8_t> m_strings;
-};
\ No newline at end of file
+    radix_jump_table m_jump_table;
+    Tracer m_tracer;
+
+    static byte_range suffix(byte_range br) {
+        uint64_t size = br.end - br.begin;
+        if (size <= prefix::bytes) return {br.end, br.end};
+        return {br.begin + prefix::bytes, br.end};
+    }
+
+    template <typename Less>
+    uint64_t search(uint64_t begin, uint64_t end, byte_range val, Less less) const {
+        int64_t count = end - begin;
+        int64_t step = 0;
+        uint64_t i = begin;
+        uint64_t ret = begin;
+        while (count > 0) {
+            i = ret;
+            step = count / 2;
+            i += step;
+            byte_range string = access(i);
+            m_tracer.probe(&m_strings_offsets[i], 2 * sizeof(pointer_type));
+            trace_compare(m_tracer, string, val);
+            if (less(string, val)) {
+                ret = ++i;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+        assert(ret <= size());
+        return ret;
+    }
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <cassert>
+#include <stdexcept>
+
+#include "util.hpp"
+
+/* A direct-mapped table, indexed by the first two bytes k of a string (zero-padded, as in
+   integer_prefix), storing the position of the first element of a sorted sequence whose
+   key is >= k. The lower bound of a string whose key is k is then in
+   [m_offsets[k], m_offsets[k + 1]], so a binary search restricted to this range skips
+   the (up to 16) probes that only narrow the search down to the strings sharing
+   the first two bytes. The table takes (2^16 + 1) * 4 bytes = 256 KiB. */
+
+struct radix_jump_table {
+    typedef uint32_t pointer_type;
+    static const uint64_t num_entries = uint64_t(1) << 16;
+
+    static uint64_t key(byte_range br) {
+        uint64_t size = br.end - br.begin;
+        if (size >= 2) return (uint64_t(br.begin[0]) << 8) | br.begin[1];
+        return size ? uint64_t(br.begin[0]) << 8 : 0;
+    }
+
+    // key_of(i), for i = 0..n-1, must be non-decreasing
+    template <typename KeyOf>
+    void build(uint64_t n, KeyOf key_of) {
+        if (n >= (uint64_t(1) << (sizeof(pointer_type) * 8))) {
+            throw std::runtime_error(std::to_string(sizeof(pointer_type) * 8) +
+                                     " bits per pointers are not enough");
+        }
+        m_offsets.resize(num_entries + 1);
+        uint64_t i = 0;
+        for (uint64_t k = 0; k != num_entries; ++k) {
+            while (i != n and key_of(i) < k) ++i;
+            m_offsets[k] = i;
+        }
+        m_offsets[num_entries] = n;
+    }
+
+    bool empty() const {
+        return m_offsets.empty();
+    }
+
+    /* The range [begin, end) to search for the lower bound of a string with the given key
+       (the lower bound is end if all the elements in the range are smaller). */
+    std::pair<uint64_t, uint64_t> range(uint64_t key) const {
+        assert(key < num_entries);
+        return {m_offsets[key], m_offsets[key + 1]};
+    }
+
+    // same as above, reporting the two entries read to the tracer (see tracing.hpp)
+    template <typename Tracer>
+    std::pair<uint64_t, uint64_t> range(uint64_t key, Tracer const& tracer) const {
+        tracer.probe(m_offsets.data() + key, 2 * sizeof(pointer_type));
+        return range(key);
+    }
+
+    uint64_t bytes() const {
+        return m_offsets.size() * sizeof(pointer_type);
+    }
+
+private:
+    std::vector<pointer_type> m_offsets;
+};
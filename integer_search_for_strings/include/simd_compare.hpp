@@ -0,0 +1,282 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <immintrin.h>
+
+/* Comparison, longest-common-prefix (LCP) and substring search kernels for byte strings.
+
+   One kernel per ISA level is compiled with the corresponding target attribute,
+   so that the code does not depend on -march. The fastest kernel supported by
+   the running CPU is selected once at startup via CPUID and can be overridden
+   with simd::use (e.g., to benchmark the different levels). */
+
+namespace simd {
+
+enum class isa { scalar, sse42, avx2, avx512 };
+
+static const isa all_isas[] = {isa::scalar, isa::sse42, isa::avx2, isa::avx512};
+
+// Return the length of the longest common prefix of a[0..n) and b[0..n).
+typedef uint64_t (*lcp_function)(uint8_t const* a, uint8_t const* b, uint64_t n);
+
+// Return the position of the first occurrence of p[0..m) in s[0..n), or n if there is none.
+typedef uint64_t (*find_function)(uint8_t const* s, uint64_t n, uint8_t const* p, uint64_t m);
+
+namespace detail {
+
+// NOTE: assumes a little-endian machine, so that the lowest set bit of x ^ y
+// belongs to the first mismatching byte
+inline uint64_t lcp_words(uint8_t const* a, uint8_t const* b, uint64_t i, uint64_t n) {
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        if (x != y) return i + (__builtin_ctzll(x ^ y) >> 3);
+    }
+    while (i != n and a[i] == b[i]) ++i;
+    return i;
+}
+
+inline uint64_t lcp_scalar(uint8_t const* a, uint8_t const* b, uint64_t n) {
+    return lcp_words(a, b, 0, n);
+}
+
+__attribute__((target("sse4.2"))) inline uint64_t lcp_sse42(uint8_t const* a, uint8_t const* b,
+                                                             uint64_t n) {
+    uint64_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<__m128i const*>(b + i));
+        uint32_t neq = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xFFFF;
+        if (neq) return i + __builtin_ctz(neq);
+    }
+    return lcp_words(a, b, i, n);
+}
+
+__attribute__((target("avx2"))) inline uint64_t lcp_avx2(uint8_t const* a, uint8_t const* b,
+                                                         uint64_t n) {
+    uint64_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + i));
+        uint32_t neq = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+        if (neq) return i + __builtin_ctz(neq);
+    }
+    if (i + 16 <= n) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<__m128i const*>(b + i));
+        uint32_t neq = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xFFFF;
+        if (neq) return i + __builtin_ctz(neq);
+        i += 16;
+    }
+    return lcp_words(a, b, i, n);
+}
+
+/* Masked loads do not fault on the bytes that are masked out,
+   hence the tail is handled without any scalar code. */
+__attribute__((target("avx512f,avx512bw"))) inline uint64_t lcp_avx512(uint8_t const* a,
+                                                                       uint8_t const* b,
+                                                                       uint64_t n) {
+    uint64_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i x = _mm512_loadu_si512(a + i);
+        __m512i y = _mm512_loadu_si512(b + i);
+        uint64_t neq = _mm512_cmpneq_epi8_mask(x, y);
+        if (neq) return i + __builtin_ctzll(neq);
+    }
+    if (i == n) return n;
+    __mmask64 valid = (uint64_t(1) << (n - i)) - 1;
+    __m512i x = _mm512_maskz_loadu_epi8(valid, a + i);
+    __m512i y = _mm512_maskz_loadu_epi8(valid, b + i);
+    uint64_t neq = _mm512_mask_cmpneq_epi8_mask(valid, x, y);
+    if (neq) return i + __builtin_ctzll(neq);
+    return n;
+}
+
+inline uint64_t find_scalar(uint8_t const* s, uint64_t n, uint8_t const* p, uint64_t m) {
+    assert(m > 0);
+    if (m > n) return n;
+    uint8_t const* last = s + n - m;
+    for (uint8_t const* x = s; x <= last; ++x) {
+        x = static_cast<uint8_t const*>(memchr(x, p[0], last - x + 1));
+        if (!x) break;
+        if (memcmp(x + 1, p + 1, m - 1) == 0) return x - s;
+    }
+    return n;
+}
+
+/* The vectorized kernels compare the first and the last byte of the pattern with
+   a block of candidate positions at once, and verify only the positions where both match. */
+
+__attribute__((target("sse4.2"))) inline uint64_t find_sse42(uint8_t const* s, uint64_t n,
+                                                              uint8_t const* p, uint64_t m) {
+    assert(m > 0);
+    if (m > n) return n;
+    __m128i first = _mm_set1_epi8(p[0]);
+    __m128i last = _mm_set1_epi8(p[m - 1]);
+    uint64_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + i + m - 1));
+        uint32_t mask = _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(x, first), _mm_cmpeq_epi8(y, last)));
+        for (; mask; mask &= mask - 1) {
+            uint64_t k = i + __builtin_ctz(mask);
+            if (memcmp(s + k, p, m) == 0) return k;
+        }
+    }
+    return i + find_scalar(s + i, n - i, p, m);
+}
+
+__attribute__((target("avx2"))) inline uint64_t find_avx2(uint8_t const* s, uint64_t n,
+                                                          uint8_t const* p, uint64_t m) {
+    assert(m > 0);
+    if (m > n) return n;
+    __m256i first = _mm256_set1_epi8(p[0]);
+    __m256i last = _mm256_set1_epi8(p[m - 1]);
+    uint64_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(s + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(s + i + m - 1));
+        uint32_t mask = _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(x, first), _mm256_cmpeq_epi8(y, last)));
+        for (; mask; mask &= mask - 1) {
+            uint64_t k = i + __builtin_ctz(mask);
+            if (memcmp(s + k, p, m) == 0) return k;
+        }
+    }
+    return i + find_scalar(s + i, n - i, p, m);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline uint64_t find_avx512(uint8_t const* s,
+                                                                        uint64_t n,
+                                                                        uint8_t const* p,
+                                                                        uint64_t m) {
+    assert(m > 0);
+    if (m > n) return n;
+    __m512i first = _mm512_set1_epi8(p[0]);
+    __m512i last = _mm512_set1_epi8(p[m - 1]);
+    uint64_t i = 0;
+    for (; i + m - 1 + 64 <= n; i += 64) {
+        __m512i x = _mm512_loadu_si512(s + i);
+        __m512i y = _mm512_loadu_si512(s + i + m - 1);
+        uint64_t mask = _mm512_cmpeq_epi8_mask(x, first) & _mm512_cmpeq_epi8_mask(y, last);
+        for (; mask; mask &= mask - 1) {
+            uint64_t k = i + __builtin_ctzll(mask);
+            if (memcmp(s + k, p, m) == 0) return k;
+        }
+    }
+    return i + find_scalar(s + i, n - i, p, m);
+}
+
+}  // namespace detail
+
+inline char const* name(isa level) {
+    switch (level) {
+        case isa::sse42:
+            return "sse4.2";
+        case isa::avx2:
+            return "avx2";
+        case isa::avx512:
+            return "avx512";
+        default:
+            return "scalar";
+    }
+}
+
+inline bool supported(isa level) {
+    __builtin_cpu_init();
+    switch (level) {
+        case isa::sse42:
+            return __builtin_cpu_supports("sse4.2");
+        case isa::avx2:
+            return __builtin_cpu_supports("avx2");
+        case isa::avx512:
+            return __builtin_cpu_supports("avx512f") and __builtin_cpu_supports("avx512bw");
+        default:
+            return true;
+    }
+}
+
+inline isa detect() {
+    if (supported(isa::avx512)) return isa::avx512;
+    if (supported(isa::avx2)) return isa::avx2;
+    if (supported(isa::sse42)) return isa::sse42;
+    return isa::scalar;
+}
+
+inline lcp_function lcp_kernel(isa level) {
+    switch (level) {
+        case isa::sse42:
+            return detail::lcp_sse42;
+        case isa::avx2:
+            return detail::lcp_avx2;
+        case isa::avx512:
+            return detail::lcp_avx512;
+        default:
+            return detail::lcp_scalar;
+    }
+}
+
+inline find_function find_kernel(isa level) {
+    switch (level) {
+        case isa::sse42:
+            return detail::find_sse42;
+        case isa::avx2:
+            return detail::find_avx2;
+        case isa::avx512:
+            return detail::find_avx512;
+        default:
+            return detail::find_scalar;
+    }
+}
+
+struct dispatcher {
+    dispatcher() {
+        use(detect());
+    }
+
+    void use(isa l) {
+        if (!supported(l)) l = isa::scalar;
+        level = l;
+        lcp = lcp_kernel(l);
+        find = find_kernel(l);
+    }
+
+    isa level;
+    lcp_function lcp;
+    find_function find;
+};
+
+inline dispatcher active;  // initialized at startup
+
+/* Select the kernels of the given ISA level (falls back to scalar
+   if the level is not supported by the CPU). */
+inline void use(isa level) {
+    active.use(level);
+}
+
+inline isa current() {
+    return active.level;
+}
+
+inline uint64_t lcp(uint8_t const* a, uint8_t const* b, uint64_t n) {
+    return active.lcp(a, b, n);
+}
+
+// the pattern must not be empty
+inline uint64_t find(uint8_t const* s, uint64_t n, uint8_t const* p, uint64_t m) {
+    return active.find(s, n, p, m);
+}
+
+// Same semantics as memcmp followed by a comparison of the lengths.
+inline int compare(uint8_t const* l, uint64_t size_l, uint8_t const* r, uint64_t size_r) {
+    uint64_t n = size_l < size_r ? size_l : size_r;
+    uint64_t i = active.lcp(l, r, n);
+    if (i != n) return int(l[i]) - int(r[i]);
+    return int(size_l) - int(size_r);
+}
+
+}  // namespace simd
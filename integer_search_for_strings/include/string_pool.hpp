@@ -2,16 +2,29 @@
 
 #include <vector>
 #include <string>
+#include <iterator>
+#include <algorithm>
 #include <cassert>
 
 #include "util.hpp"
+#include "radix_jump_table.hpp"
+#include "tracing.hpp"
 
 /* A pool of strings. Differently from a std::vector<std::string>, this class
 uses a contiguous chunk of memory and uses integer pointers to keep track of
-where each individual string begins (and ends). It also avoids the null terminator '\0'. */
+where each individual string begins (and ends). It also avoids the null terminator '\0'.
 
-struct string_pool {
+The pointers only keep the low 32 bits of the offsets, so that the pool is logically
+divided into segments of 4 GiB: a (small) segment directory stores the ID of the
+first pointer of each segment, and the high bits of a pointer are the number of
+segments starting at or before it. Pools smaller than 4 GiB have no directory.
+
+The probes of lower_bound are reported to a Tracer (see tracing.hpp). */
+
+template <typename Tracer = no_tracer>
+struct basic_string_pool {
     typedef uint32_t pointer_type;
+    static constexpr uint64_t segment_bits = sizeof(pointer_type) * 8;
 
     struct builder {
         builder(uint64_t num_strings = 0) {
@@ -21,37 +34,43 @@ struct string_pool {
 
         template <typename Iterator>
         void build(Iterator begin, uint64_t n) {
-            for (uint64_t i = 0; i != n; ++i, ++begin) {
-                append(byte_range_from_string(*begin));
-                if (m_strings.size() > (uint64_t(1) << (sizeof(pointer_type) * 8))) {
-                    throw std::runtime_error(std::to_string(sizeof(pointer_type) * 8) +
-                                             " bits per pointers are not enough");
-                }
-            }
+            for (uint64_t i = 0; i != n; ++i, ++begin) append(byte_range_from_string(*begin));
+        }
+
+        void reserve(uint64_t bytes) {
+            m_strings.reserve(bytes);
         }
 
         void append(byte_range br) {
             m_strings.insert(m_strings.end(), br.begin, br.end);
-            m_endpoints.push_back(m_strings.size());
+            uint64_t endpoint = m_strings.size();
+            // NOTE: a string longer than a segment spans more than one
+            while ((endpoint >> segment_bits) > m_segments.size()) {
+                m_segments.push_back(m_endpoints.size());
+            }
+            m_endpoints.push_back(static_cast<pointer_type>(endpoint));
         }
 
-        void build(string_pool& pool) {
+        void build(basic_string_pool& pool) {
             pool.m_endpoints.swap(m_endpoints);
             pool.m_strings.swap(m_strings);
+            pool.m_segments.swap(m_segments);
             swap(*this);
         }
 
         void swap(builder& other) {
             other.m_endpoints.swap(m_endpoints);
             other.m_strings.swap(m_strings);
+            other.m_segments.swap(m_segments);
         }
 
     private:
         std::vector<pointer_type> m_endpoints;
         std::vector<uint8_t> m_strings;
+        std::vector<uint64_t> m_segments;
     };
 
-    string_pool() {}
+    basic_string_pool() {}
 
     uint64_t size() const {
         assert(m_endpoints.size() > 0);
@@ -60,23 +79,99 @@ struct string_pool {
 
     byte_range access(uint64_t i) const {
         assert(i < size());
-        auto begin = m_endpoints[i];
-        auto end = m_endpoints[i + 1];
+        uint64_t begin = m_endpoints[i];
+        uint64_t end = m_endpoints[i + 1];
+        if (!m_segments.empty()) {
+            begin = endpoint(i);
+            end = endpoint(i + 1);
+        }
         uint8_t const* base = reinterpret_cast<uint8_t const*>(m_strings.data());
         return {base + begin, base + end};
     }
 
+    /* Iterates over the strings as std::string objects, so that a pool (e.g., sorted with
+       sorting::sort_and_deduplicate) can be given to the builders of the other dictionaries. */
+    struct iterator {
+        typedef std::input_iterator_tag iterator_category;
+        typedef std::string value_type;
+        typedef std::string reference;
+        typedef void pointer;
+        typedef int64_t difference_type;
+
+        iterator(basic_string_pool const* pool, uint64_t i) : m_pool(pool), m_i(i) {}
+
+        std::string operator*() const {
+            byte_range br = m_pool->access(m_i);
+            return std::string(reinterpret_cast<char const*>(br.begin), br.end - br.begin);
+        }
+
+        iterator& operator++() {
+            ++m_i;
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator copy = *this;
+            ++m_i;
+            return copy;
+        }
+
+        bool operator==(iterator const& other) const {
+            return m_i == other.m_i;
+        }
+
+        bool operator!=(iterator const& other) const {
+            return m_i != other.m_i;
+        }
+
+    private:
+        basic_string_pool const* m_pool;
+        uint64_t m_i;
+    };
+
+    iterator begin() const {
+        return iterator(this, 0);
+    }
+
+    iterator end() const {
+        return iterator(this, size());
+    }
+
+    void set_tracer(Tracer tracer) {
+        m_tracer = tracer;
+    }
+
+    Tracer const& tracer() const {
+        return m_tracer;
+    }
+
+    // optional: restrict the binary searches of lower_bound with a radix_jump_table
+    void build_jump_table() {
+        m_jump_table.build(size(), [&](uint64_t i) { return radix_jump_table::key(access(i)); });
+    }
+
     uint64_t lower_bound(std::string const& val) const {
+        return lower_bound(byte_range_from_string(val));
+    }
+
+    uint64_t lower_bound(byte_range target) const {
         int64_t count = size();
         int64_t step = 0;
         uint64_t i = 0;
         uint64_t ret = 0;
-        auto target = byte_range_from_string(val);
+        if (!m_jump_table.empty()) {
+            auto [begin, end] = m_jump_table.range(radix_jump_table::key(target), m_tracer);
+            ret = begin;
+            count = end - begin;
+        }
         while (count > 0) {
             i = ret;
             step = count / 2;
             i += step;
-            int cmp = byte_range_compare(access(i), target);
+            byte_range string = access(i);
+            m_tracer.probe(&m_endpoints[i], 2 * sizeof(pointer_type));
+            trace_compare(m_tracer, string, target);
+            int cmp = byte_range_compare(string, target);
             if (cmp < 0) {
                 ret = ++i;
                 count -= step + 1;
@@ -87,12 +182,60 @@ struct string_pool {
         return ret;
     }
 
+    /* The IDs of the strings that contain pattern, in increasing order, found with a linear
+       scan of the pool (a baseline for fm_index::locate). */
+    void locate(byte_range pattern, std::vector<uint64_t>& ids) const {
+        ids.clear();
+        uint64_t m = pattern.end - pattern.begin;
+        if (m == 0) {
+            for (uint64_t id = 0; id != size(); ++id) ids.push_back(id);
+            return;
+        }
+        uint8_t const* base = m_strings.data();
+        uint64_t n = m_strings.size();
+        uint64_t i = 0;
+        while (true) {
+            uint64_t p = i + simd::find(base + i, n - i, pattern.begin, m);
+            if (p == n) break;
+            // the last string beginning at or before p
+            uint64_t lo = 0, hi = size();
+            while (hi - lo > 1) {
+                uint64_t mid = (lo + hi) / 2;
+                if (endpoint(mid) <= p) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            uint64_t id = lo;
+            if (p + m <= endpoint(id + 1)) {
+                ids.push_back(id);
+                i = endpoint(id + 1);  // skip the rest of the string
+            } else {
+                i = p + 1;  // the occurrence spans two strings
+            }
+        }
+    }
+
     uint64_t bytes() const {
         return m_endpoints.size() * sizeof(m_endpoints.front()) +
-               m_strings.size() * sizeof(m_strings.front());
+               m_strings.size() * sizeof(m_strings.front()) +
+               m_segments.size() * sizeof(m_segments.front()) + m_jump_table.bytes();
     }
 
 private:
     std::vector<pointer_type> m_endpoints;
     std::vector<uint8_t> m_strings;
-};
\ No newline at end of file
+    std::vector<uint64_t> m_segments;  // ID of the first pointer of the segments 1, 2, ...
+    radix_jump_table m_jump_table;
+    Tracer m_tracer;
+
+    // the full offset of the i-th pointer
+    uint64_t endpoint(uint64_t i) const {
+        uint64_t segment =
+            std::upper_bound(m_segments.begin(), m_segments.end(), i) - m_segments.begin();
+        return (segment << segment_bits) | m_endpoints[i];
+    }
+};
+
+typedef basic_string_pool<> string_pool;
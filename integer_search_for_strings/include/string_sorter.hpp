@@ -0,0 +1,321 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdio>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <queue>
+#include <algorithm>
+#include <cassert>
+
+#include "util.hpp"
+#include "string_pool.hpp"
+
+/* Sorting (and deduplication) of string collections, so that the dictionaries
+   can be built from unsorted input.
+
+   - parallel_sort is a most-significant-digit (MSD) radix sort: the ranges that are
+     larger than a threshold are distributed by their byte at the current depth with all
+     threads (each thread counts and scatters a chunk of the range); the remaining ranges
+     are sorted independently by the threads, with a sequential MSD radix sort that
+     switches to insertion sort (comparing from the current depth) for small ranges.
+   - external_sort handles inputs larger than the memory budget: sorted runs of distinct
+     strings are written to disk and then merged with a k-way merge. */
+
+namespace sorting {
+
+static const uint64_t insertion_sort_threshold = 32;
+
+inline uint64_t default_threads() {
+    return std::max<uint64_t>(1, std::thread::hardware_concurrency());
+}
+
+// 0 for a string that ends before depth, 1 + its byte at depth otherwise
+inline uint64_t key(byte_range br, uint64_t depth) {
+    return br.begin + depth < br.end ? uint64_t(br.begin[depth]) + 1 : 0;
+}
+
+inline void insertion_sort(byte_range* begin, byte_range* end, uint64_t depth) {
+    for (byte_range* i = begin + 1; i < end; ++i) {
+        byte_range x = *i;
+        byte_range* j = i;
+        for (; j != begin; --j) {
+            byte_range y = *(j - 1);
+            if (simd::compare(y.begin + depth, y.end - y.begin - depth, x.begin + depth,
+                              x.end - x.begin - depth) <= 0) {
+                break;
+            }
+            *j = y;
+        }
+        *j = x;
+    }
+}
+
+/* |lcp| of the strings in [begin, end) beyond depth, i.e., how much the common prefix
+   of the range extends past its first depth bytes. */
+inline uint64_t common_prefix(byte_range const* begin, byte_range const* end, uint64_t depth) {
+    uint64_t l = begin->end - begin->begin - depth;
+    for (byte_range const* p = begin + 1; p != end and l != 0; ++p) {
+        l = simd::lcp(begin->begin + depth, p->begin + depth,
+                      std::min<uint64_t>(l, p->end - p->begin - depth));
+    }
+    return l;
+}
+
+struct range {
+    uint64_t begin, end, depth;
+};
+
+/* Sequential MSD radix sort of the strings in [begin, end), sharing a prefix of length depth.
+   The ranges still to sort are kept on an explicit stack, so that long shared prefixes do
+   not overflow the call stack. When all the strings of a range fall into the same bucket,
+   the range skips to the end of its common prefix instead of descending one byte at a time
+   (a range of equal strings is then done). */
+inline void msd_radix_sort(byte_range* begin, byte_range* end, uint64_t depth,
+                           std::vector<byte_range>& tmp) {
+    std::vector<range> stack = {{0, uint64_t(end - begin), depth}};
+    while (!stack.empty()) {
+        range r = stack.back();
+        stack.pop_back();
+        byte_range* first = begin + r.begin;
+        byte_range* last = begin + r.end;
+        uint64_t n = r.end - r.begin;
+        if (n < insertion_sort_threshold) {
+            insertion_sort(first, last, r.depth);
+            continue;
+        }
+        uint64_t counts[257] = {0};
+        for (byte_range* p = first; p != last; ++p) counts[key(*p, r.depth)] += 1;
+        uint64_t k = key(*first, r.depth);
+        if (counts[k] == n) {
+            // bucket 0 holds strings that are all equal to the common prefix
+            if (k != 0) {
+                stack.push_back({r.begin, r.end, r.depth + common_prefix(first, last, r.depth)});
+            }
+            continue;
+        }
+        uint64_t offsets[257];
+        uint64_t sum = 0;
+        for (uint64_t b = 0; b != 257; ++b) {
+            offsets[b] = sum;
+            sum += counts[b];
+        }
+        tmp.resize(std::max<uint64_t>(tmp.size(), n));
+        for (byte_range* p = first; p != last; ++p) tmp[offsets[key(*p, r.depth)]++] = *p;
+        std::copy(tmp.begin(), tmp.begin() + n, first);
+        uint64_t p = r.begin + counts[0];
+        for (uint64_t b = 1; b != 257; ++b) {
+            if (counts[b] > 1) stack.push_back({p, p + counts[b], r.depth + 1});
+            p += counts[b];
+        }
+    }
+}
+
+/* Distribute the strings of [begin, end) by their byte at depth, using num_threads threads,
+   and write the bucket boundaries in bounds (257 + 1 entries). */
+inline void parallel_distribute(byte_range* begin, byte_range* end, uint64_t depth,
+                                uint64_t num_threads, std::vector<byte_range>& tmp,
+                                uint64_t* bounds) {
+    uint64_t n = end - begin;
+    uint64_t chunk = (n + num_threads - 1) / num_threads;
+    std::vector<std::array<uint64_t, 257>> counts(num_threads);
+    auto run = [&](auto&& f) {
+        std::vector<std::thread> threads;
+        for (uint64_t t = 0; t != num_threads; ++t) threads.emplace_back(f, t);
+        for (auto& t : threads) t.join();
+    };
+
+    run([&](uint64_t t) {
+        counts[t].fill(0);
+        byte_range* last = begin + std::min(n, (t + 1) * chunk);
+        for (byte_range* p = begin + std::min(n, t * chunk); p < last; ++p) {
+            counts[t][key(*p, depth)] += 1;
+        }
+    });
+
+    // the strings of chunk t in bucket b go after those of the chunks before t
+    uint64_t sum = 0;
+    for (uint64_t b = 0; b != 257; ++b) {
+        bounds[b] = sum;
+        for (uint64_t t = 0; t != num_threads; ++t) {
+            uint64_t c = counts[t][b];
+            counts[t][b] = sum;
+            sum += c;
+        }
+    }
+    bounds[257] = sum;
+    assert(sum == n);
+
+    tmp.resize(std::max<uint64_t>(tmp.size(), n));
+    run([&](uint64_t t) {
+        byte_range* last = begin + std::min(n, (t + 1) * chunk);
+        for (byte_range* p = begin + std::min(n, t * chunk); p < last; ++p) {
+            tmp[counts[t][key(*p, depth)]++] = *p;
+        }
+    });
+    run([&](uint64_t t) {
+        uint64_t first = std::min(n, t * chunk);
+        uint64_t last = std::min(n, (t + 1) * chunk);
+        std::copy(tmp.begin() + first, tmp.begin() + last, begin + first);
+    });
+}
+
+inline void parallel_sort(std::vector<byte_range>& strings, uint64_t num_threads) {
+    num_threads = std::max<uint64_t>(num_threads, 1);
+    uint64_t n = strings.size();
+    uint64_t threshold = std::max<uint64_t>(uint64_t(1) << 16, n / (4 * num_threads));
+
+    std::vector<range> large = {{0, n, 0}}, small;
+    std::vector<byte_range> tmp;
+    uint64_t bounds[258];
+    while (!large.empty()) {
+        range r = large.back();
+        large.pop_back();
+        if (r.end - r.begin <= threshold or num_threads == 1) {
+            if (r.end - r.begin > 1) small.push_back(r);
+            continue;
+        }
+        parallel_distribute(strings.data() + r.begin, strings.data() + r.end, r.depth,
+                            num_threads, tmp, bounds);
+        // as in msd_radix_sort, a single bucket skips to the end of the common prefix
+        if (bounds[1] == r.end - r.begin) continue;  // all equal to the common prefix
+        for (uint64_t b = 1; b != 257; ++b) {
+            if (bounds[b + 1] - bounds[b] == r.end - r.begin) {
+                r.depth += common_prefix(strings.data() + r.begin, strings.data() + r.end,
+                                         r.depth);
+                large.push_back(r);
+                break;
+            }
+            if (bounds[b + 1] - bounds[b] > 1) {
+                large.push_back({r.begin + bounds[b], r.begin + bounds[b + 1], r.depth + 1});
+            }
+        }
+    }
+    std::vector<byte_range>().swap(tmp);
+
+    // largest ranges first, for load balancing
+    std::sort(small.begin(), small.end(), [](range const& x, range const& y) {
+        return x.end - x.begin > y.end - y.begin;
+    });
+    std::atomic<uint64_t> next(0);
+    auto sort_ranges = [&]() {
+        std::vector<byte_range> tmp;
+        for (uint64_t i = next++; i < small.size(); i = next++) {
+            msd_radix_sort(strings.data() + small[i].begin, strings.data() + small[i].end,
+                           small[i].depth, tmp);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint64_t t = 1; t < num_threads; ++t) threads.emplace_back(sort_ranges);
+    sort_ranges();
+    for (auto& t : threads) t.join();
+}
+
+inline bool equal(byte_range x, byte_range y) {
+    return byte_range_compare(x, y) == 0;
+}
+
+// return the distinct strings of the pool, in sorted order
+inline string_pool sort_and_deduplicate(string_pool const& pool,
+                                        uint64_t num_threads = default_threads()) {
+    std::vector<byte_range> strings(pool.size());
+    for (uint64_t i = 0; i != pool.size(); ++i) strings[i] = pool.access(i);
+    parallel_sort(strings, num_threads);
+    strings.erase(std::unique(strings.begin(), strings.end(), equal), strings.end());
+    uint64_t bytes = 0;
+    for (auto br : strings) bytes += br.end - br.begin;
+    string_pool::builder builder(strings.size());
+    builder.reserve(bytes);
+    for (auto br : strings) builder.append(br);
+    string_pool sorted;
+    builder.build(sorted);
+    return sorted;
+}
+
+inline string_pool sort_and_deduplicate(std::vector<std::string> const& strings,
+                                        uint64_t num_threads = default_threads()) {
+    string_pool::builder builder(strings.size());
+    builder.build(strings.begin(), strings.size());
+    string_pool pool;
+    builder.build(pool);
+    return sort_and_deduplicate(pool, num_threads);
+}
+
+/* Sort the strings of the input file (one per line), removing duplicates, and write them
+   to the output file. At most (about) memory_budget bytes of strings are sorted in memory
+   at a time: if the input is larger, sorted runs are written to output.run<i> and then
+   merged. Return the number of distinct strings. */
+inline uint64_t external_sort(std::string const& input_filename,
+                              std::string const& output_filename, uint64_t memory_budget,
+                              uint64_t num_threads = default_threads()) {
+    std::ifstream input(input_filename);
+    if (!input) throw std::runtime_error("cannot open " + input_filename);
+
+    std::vector<std::string> runs;
+    auto write_run = [&](string_pool::builder& builder, std::string const& filename) {
+        string_pool pool;
+        builder.build(pool);
+        string_pool::builder().swap(builder);
+        string_pool sorted = sort_and_deduplicate(pool, num_threads);
+        std::ofstream out(filename);
+        if (!out) throw std::runtime_error("cannot open " + filename);
+        for (uint64_t i = 0; i != sorted.size(); ++i) {
+            byte_range br = sorted.access(i);
+            out.write(reinterpret_cast<char const*>(br.begin), br.end - br.begin);
+            out.put('\n');
+        }
+        return sorted.size();
+    };
+
+    std::string s;
+    string_pool::builder builder;
+    uint64_t bytes = 0;
+    uint64_t num_strings = 0;
+    while (std::getline(input, s)) {
+        builder.append(byte_range_from_string(s));
+        bytes += s.size() + sizeof(string_pool::pointer_type) + sizeof(byte_range);
+        if (bytes >= memory_budget) {
+            runs.push_back(output_filename + ".run" + std::to_string(runs.size()));
+            write_run(builder, runs.back());
+            bytes = 0;
+        }
+    }
+    input.close();
+    if (runs.empty()) return write_run(builder, output_filename);
+    if (bytes) {
+        runs.push_back(output_filename + ".run" + std::to_string(runs.size()));
+        write_run(builder, runs.back());
+    }
+    std::cout << "merging " << runs.size() << " sorted runs" << std::endl;
+
+    // k-way merge with a min-heap of the current string of each run
+    std::vector<std::ifstream> inputs;
+    std::vector<std::string> heads(runs.size());
+    for (auto const& run : runs) inputs.emplace_back(run);
+    auto greater = [&](uint64_t x, uint64_t y) { return heads[x] > heads[y]; };
+    std::priority_queue<uint64_t, std::vector<uint64_t>, decltype(greater)> heap(greater);
+    for (uint64_t i = 0; i != runs.size(); ++i) {
+        if (std::getline(inputs[i], heads[i])) heap.push(i);
+    }
+    std::ofstream out(output_filename);
+    if (!out) throw std::runtime_error("cannot open " + output_filename);
+    std::string last;
+    while (!heap.empty()) {
+        uint64_t i = heap.top();
+        heap.pop();
+        if (num_strings == 0 or heads[i] != last) {
+            out << heads[i] << '\n';
+            last = heads[i];
+            num_strings += 1;
+        }
+        if (std::getline(inputs[i], heads[i])) heap.push(i);
+    }
+    out.close();
+    for (auto const& run : runs) std::remove(run.c_str());
+    return num_strings;
+}
+
+}  // namespace sorting
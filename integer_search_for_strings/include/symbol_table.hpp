@@ -0,0 +1,208 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <cassert>
+
+#include "util.hpp"
+
+enum class suffix_codec { plain, fsst };
+
+inline char const* codec_name(suffix_codec codec) {
+    return codec == suffix_codec::fsst ? "fsst" : "plain";
+}
+
+/* A static table of (at most 255) frequent symbols of 1-8 bytes, in the spirit of FSST
+   [Boncz et al., VLDB 2020]. A string is encoded as a sequence of 1-byte codes:
+   code c < 255 stands for the symbol c and code 255 (escape) is followed by a literal byte.
+
+   The table is learned from a sample of strings in a few rounds: each round encodes the sample
+   with the current table and keeps the 255 candidates with the highest gain (frequency times
+   length), where candidates are the symbols and literals used in the encoding, and the
+   concatenations of two consecutive ones (of at most 8 bytes).
+
+   Decoding writes 8 bytes per symbol, hence the output buffer needs slack bytes of room
+   past the end of the decoded string. */
+
+struct symbol_table {
+    static constexpr uint8_t escape = 255;
+    static constexpr uint64_t max_symbols = 255;
+    static constexpr uint64_t max_symbol_length = 8;
+    static constexpr uint64_t slack = max_symbol_length;
+
+    symbol_table() : m_num_symbols(0) {
+        std::fill(m_symbols, m_symbols + 256, 0);
+        std::fill(m_lengths, m_lengths + 256, 0);
+    }
+
+    void build(std::vector<std::string> const& sample) {
+        static const uint64_t rounds = 5;
+        for (uint64_t r = 0; r != rounds; ++r) {
+            std::unordered_map<std::string, uint64_t> gain;
+            for (auto const& s : sample) {
+                byte_range br = byte_range_from_string(s);
+                std::string prev;
+                while (br.begin != br.end) {
+                    uint64_t len = 1;
+                    find(br, &len);
+                    std::string curr(br.begin, br.begin + len);
+                    gain[curr] += len;
+                    if (!prev.empty() and prev.size() + curr.size() <= max_symbol_length) {
+                        gain[prev + curr] += prev.size() + curr.size();
+                    }
+                    prev.swap(curr);
+                    br.begin += len;
+                }
+            }
+            std::vector<std::pair<uint64_t, std::string>> candidates;
+            candidates.reserve(gain.size());
+            for (auto const& [symbol, g] : gain) candidates.emplace_back(g, symbol);
+            uint64_t k = std::min<uint64_t>(max_symbols, candidates.size());
+            std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end(),
+                              [](auto const& x, auto const& y) {
+                                  if (x.first != y.first) return x.first > y.first;
+                                  return x.second < y.second;
+                              });
+            std::vector<std::string> symbols;
+            for (uint64_t i = 0; i != k; ++i) symbols.push_back(candidates[i].second);
+            set(symbols);
+        }
+    }
+
+    uint64_t size() const {
+        return m_num_symbols;
+    }
+
+    void encode(byte_range br, std::vector<uint8_t>& out) const {
+        while (br.begin != br.end) {
+            uint64_t len = 1;
+            int code = find(br, &len);
+            if (code < 0) {
+                out.push_back(escape);
+                out.push_back(*br.begin);
+            } else {
+                out.push_back(code);
+            }
+            br.begin += len;
+        }
+    }
+
+    // decode the codes in [in, end) into out and return the end of the decoded string
+    uint8_t* decode(uint8_t const* in, uint8_t const* end, uint8_t* out) const {
+        while (in != end) {
+            uint8_t code = *in++;
+            if (code == escape) {
+                *out++ = *in++;
+                continue;
+            }
+            memcpy(out, &m_symbols[code], sizeof(uint64_t));
+            out += m_lengths[code];
+        }
+        return out;
+    }
+
+    /* Compare the string encoded in [in, end) with q (as memcmp followed by a comparison
+       of the lengths) and set lcp to the length of their longest common prefix. */
+    int compare(uint8_t const* in, uint8_t const* end, byte_range q, uint64_t* lcp) const {
+        return compare_codes<false>(in, end, q, lcp);
+    }
+
+    /* Same as compare, but the encoded string s is compared with the prefix of q of length |s|:
+       the result is 0 if s is a prefix of q (and lcp is then set to |s|). */
+    int compare_prefix(uint8_t const* in, uint8_t const* end, byte_range q, uint64_t* lcp) const {
+        return compare_codes<true>(in, end, q, lcp);
+    }
+
+    uint64_t bytes() const {
+        return sizeof(m_symbols) + sizeof(m_lengths);
+    }
+
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(m_num_symbols);
+        visitor.visit(m_symbols);
+        visitor.visit(m_lengths);
+    }
+
+private:
+    uint64_t m_num_symbols;
+    uint64_t m_symbols[256];  // the bytes of a symbol, in memory order
+    uint8_t m_lengths[256];
+
+    // symbol codes, by first byte, in decreasing order of length
+    std::vector<uint8_t> m_by_first_byte[256];
+
+    template <bool Prefix>
+    int compare_codes(uint8_t const* in, uint8_t const* end, byte_range q, uint64_t* lcp) const {
+        uint64_t q_len = q.end - q.begin;
+        uint64_t j = 0;
+        while (in != end) {
+            uint8_t code = *in++;
+            uint64_t symbol, len;
+            if (code == escape) {
+                symbol = *in++;
+                len = 1;
+            } else {
+                symbol = m_symbols[code];
+                len = m_lengths[code];
+            }
+            uint64_t remaining = q_len - j;
+            uint64_t n = std::min(len, remaining);
+            uint64_t word = 0;
+            if (remaining >= sizeof(uint64_t)) {
+                memcpy(&word, q.begin + j, sizeof(uint64_t));
+            } else {
+                memcpy(&word, q.begin + j, remaining);
+            }
+            uint64_t mask = n == sizeof(uint64_t) ? uint64_t(-1) : (uint64_t(1) << (8 * n)) - 1;
+            uint64_t x = (symbol ^ word) & mask;
+            if (x) {
+                uint64_t k = __builtin_ctzll(x) >> 3;  // NOTE: little-endian
+                *lcp = j + k;
+                return int((symbol >> (8 * k)) & 0xFF) - int(q.begin[j + k]);
+            }
+            if (len > remaining) {  // q is a proper prefix
+                *lcp = q_len;
+                return 1;
+            }
+            j += len;
+        }
+        *lcp = j;
+        return Prefix or j == q_len ? 0 : -1;
+    }
+
+    void set(std::vector<std::string> const& symbols) {
+        assert(symbols.size() <= max_symbols);
+        m_num_symbols = symbols.size();
+        for (auto& v : m_by_first_byte) v.clear();
+        for (uint64_t c = 0; c != symbols.size(); ++c) {
+            auto const& s = symbols[c];
+            assert(s.size() > 0 and s.size() <= max_symbol_length);
+            m_symbols[c] = 0;
+            memcpy(&m_symbols[c], s.data(), s.size());
+            m_lengths[c] = s.size();
+            m_by_first_byte[uint8_t(s[0])].push_back(c);
+        }
+        for (auto& v : m_by_first_byte) {
+            std::sort(v.begin(), v.end(),
+                      [&](uint8_t x, uint8_t y) { return m_lengths[x] > m_lengths[y]; });
+        }
+    }
+
+    /* Return the code of the longest symbol that is a prefix of br (and its length in len),
+       or -1 if there is none (len is then 1). Used at build time only. */
+    int find(byte_range br, uint64_t* len) const {
+        uint64_t size = br.end - br.begin;
+        for (uint8_t c : m_by_first_byte[*br.begin]) {
+            uint64_t l = m_lengths[c];
+            if (l <= size and memcmp(&m_symbols[c], br.begin, l) == 0) {
+                *len = l;
+                return c;
+            }
+        }
+        *len = 1;
+        return -1;
+    }
+};
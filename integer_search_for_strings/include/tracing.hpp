@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "util.hpp"
+
+/* Tracing policies for the searches of the dictionaries: basic_string_pool,
+   prefix_indexed_string_pool and the front-coded dictionaries take a Tracer
+   template parameter and report to it every memory probe made by lower_bound
+   and lookup, as tracer.probe(address, bytes).
+
+   - no_tracer (the default) does nothing: as its enabled flag is false,
+     the code computing what to report is also compiled away.
+   - cache_set_tracer maps the probed bytes to the sets of a cache, as the simulator of
+     cache_usage does, i.e., it counts the distinct cache lines mapped to each set. */
+
+struct no_tracer {
+    static constexpr bool enabled = false;
+    void probe(void const*, uint64_t) const {}
+};
+
+/* The distinct cache lines mapped to each set of a set-associative cache
+   (no replacement is simulated). */
+struct cache_set_usage {
+    cache_set_usage(uint64_t size, uint64_t ways, uint64_t line_size = 64)
+        : m_size(size)
+        , m_ways(ways)
+        , m_line_size(line_size)
+        , m_sets((size / line_size) / ways)
+        , m_lines(m_sets) {
+        if (size % (line_size * ways) != 0) {
+            throw std::runtime_error("cache size must be divisible by line size times ways");
+        }
+    }
+
+    void map(void const* address, uint64_t bytes) {
+        if (bytes == 0) return;
+        uint64_t begin = reinterpret_cast<uintptr_t>(address);
+        for (uint64_t line = begin / m_line_size; line <= (begin + bytes - 1) / m_line_size;
+             ++line) {
+            m_lines[line % m_sets].insert(line);
+        }
+    }
+
+    // the number of distinct lines of each set, on one line
+    void print_usage(std::ostream& os) const {
+        for (uint64_t i = 0; i != m_sets; ++i) {
+            if (i) os << " ";
+            os << m_lines[i].size();
+        }
+        os << std::endl;
+    }
+
+    // the number of distinct lines, in total and in the most used set
+    std::pair<uint64_t, uint64_t> lines() const {
+        uint64_t total = 0, max = 0;
+        for (auto const& set : m_lines) {
+            total += set.size();
+            max = std::max<uint64_t>(max, set.size());
+        }
+        return {total, max};
+    }
+
+    uint64_t sets() const {
+        return m_sets;
+    }
+
+    uint64_t ways() const {
+        return m_ways;
+    }
+
+    uint64_t size() const {
+        return m_size;
+    }
+
+    void clear() {
+        for (auto& set : m_lines) set.clear();
+    }
+
+private:
+    uint64_t m_size;  // in bytes
+    uint64_t m_ways;
+    uint64_t m_line_size;
+    uint64_t m_sets;
+    std::vector<std::unordered_set<uint64_t>> m_lines;
+};
+
+// a handle to a cache_set_usage: probes are ignored until one is given
+struct cache_set_tracer {
+    static constexpr bool enabled = true;
+
+    cache_set_tracer(cache_set_usage* usage = nullptr) : m_usage(usage) {}
+
+    void probe(void const* address, uint64_t bytes) const {
+        if (m_usage) m_usage->map(address, bytes);
+    }
+
+private:
+    cache_set_usage* m_usage;
+};
+
+// report the bytes of l read by its comparison with r, i.e., those up to the first mismatch
+template <typename Tracer>
+inline void trace_compare(Tracer const& tracer, byte_range l, byte_range r) {
+    if constexpr (Tracer::enabled) {
+        uint64_t l_size = l.end - l.begin;
+        uint64_t k = simd::lcp(l.begin, r.begin, std::min<uint64_t>(l_size, r.end - r.begin));
+        tracer.probe(l.begin, std::min(k + 1, l_size));
+    }
+}
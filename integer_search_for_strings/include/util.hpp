@@ -11,9 +11,12 @@
 #include <cassert>
 #include <immintrin.h>  // for __builtin_bswap64
 #include <cstring>
+#include <tuple>
+#include <type_traits>
+
+#include "simd_compare.hpp"
 
 namespace constants {
-static const uint64_t max_string_length = 256;
 static const uint64_t invalid_id = -1;
 }  // namespace constants
 
@@ -23,13 +26,36 @@ struct byte_range {
 };
 
 inline int byte_range_compare(byte_range l, byte_range r) {
-    int size_l = l.end - l.begin;
-    int size_r = r.end - r.begin;
-    int n = size_l < size_r ? size_l : size_r;
-    int cmp =
-        memcmp(reinterpret_cast<const char*>(l.begin), reinterpret_cast<const char*>(r.begin), n);
-    if (cmp != 0) return cmp;
-    return size_l - size_r;
+    return simd::compare(l.begin, l.end - l.begin, r.begin, r.end - r.begin);
+}
+
+// |lcp(l,r)|
+inline uint64_t string_lcp(std::string const& l, std::string const& r) {
+    uint64_t n = l.size() < r.size() ? l.size() : r.size();
+    return simd::lcp(reinterpret_cast<uint8_t const*>(l.data()),
+                     reinterpret_cast<uint8_t const*>(r.data()), n);
+}
+
+/* Variable-byte (LEB128) encoding of integers: 7 bits per byte, the least significant
+   group first, and the most significant bit of each byte set if more bytes follow. */
+inline void write_varint(std::vector<uint8_t>& out, uint64_t x) {
+    while (x >= 128) {
+        out.push_back((x & 127) | 128);
+        x >>= 7;
+    }
+    out.push_back(x);
+}
+
+// decode a varint and move in past it
+inline uint64_t read_varint(uint8_t const*& in) {
+    uint64_t x = *in++;
+    if (x < 128) return x;  // fast path: a single byte
+    x &= 127;
+    for (uint64_t shift = 7;; shift += 7) {
+        uint64_t byte = *in++;
+        x |= (byte & 127) << shift;
+        if (byte < 128) return x;
+    }
 }
 
 byte_range byte_range_from_string(std::string const& str) {
@@ -94,48 +120,6 @@ std::vector<std::string> read_string_collection(char const* filename, uint64_t m
     return strings;
 }
 
-// generic function
-// static const uint64_t prefix_size = 8;
-// uint64_t string_to_uint64(std::string const& s) {
-//     std::string tmp(s.substr(0, prefix_size));
-//     if (s.size() < prefix_size) {
-//         for (uint64_t i = 0; i != prefix_size - s.size(); ++i) tmp.push_back(0);
-//     }
-//     std::reverse(tmp.begin(), tmp.end());
-//     return *reinterpret_cast<uint64_t const*>(tmp.data());
-// }
-
-// version that assumes a prefix of size 8
-uint64_t string_to_uint64(std::string const& s) {
-    // option 1. builtin reverse of bytes
-    return __builtin_bswap64(*reinterpret_cast<uint64_t const*>(s.data()));
-
-    // option 2. manual reverse of bytes
-    // assert(s.size() >= 8);
-    // uint64_t x = (uint64_t(s[0]) << 56) + (uint64_t(s[1]) << 48) + (uint64_t(s[2]) << 40) +
-    //              (uint64_t(s[3]) << 32) + (uint64_t(s[4]) << 24) + (uint64_t(s[5]) << 16) +
-    //              (uint64_t(s[6]) << 8) + uint64_t(s[7]);
-    // return x;
-}
-
-template <uint32_t bits>
-uint64_t string_to_uint(std::string const& s) {
-    static_assert(bits == 32 or bits == 64);
-    if constexpr (bits == 32) {
-        return __builtin_bswap32(*reinterpret_cast<uint32_t const*>(s.data()));
-    }
-    return __builtin_bswap64(*reinterpret_cast<uint64_t const*>(s.data()));
-}
-
-template <uint32_t bits>
-uint64_t byte_range_to_uint(byte_range s) {
-    static_assert(bits == 32 or bits == 64);
-    if constexpr (bits == 32) {
-        return __builtin_bswap32(*reinterpret_cast<uint32_t const*>(s.begin));
-    }
-    return __builtin_bswap64(*reinterpret_cast<uint64_t const*>(s.begin));
-}
-
 #include "immintrin.h"
 
 // True if a < b, for unsigned 128 bit integers
@@ -154,41 +138,95 @@ inline bool cmplt_u128(__m128i a, __m128i b) {
     return less > greater;
 }
 
-struct uint128_t {
+/* x2 holds the most significant 64 bits, so that the
+   in-memory layout can be compared as a __m128i. */
+struct alignas(16) uint128_t {
     uint64_t x1;
     uint64_t x2;
 
+    bool operator==(uint128_t rhs) const {
+        __m128i x = _mm_load_si128(reinterpret_cast<__m128i const*>(this));
+        __m128i y = _mm_load_si128(reinterpret_cast<__m128i const*>(&rhs));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) == 0xFFFF;
+    }
     bool operator!=(uint128_t rhs) const {
-        return x1 != rhs.x1 and x2 != rhs.x2;
+        return !(*this == rhs);
     }
     bool operator<(uint128_t rhs) const {
-        __m128i x = _mm_load_si128((__m128i const*)&rhs);  //_mm_load_si128
-        return cmplt_u128(*(__m128i const*)this, x);
-        // if (x1 != rhs.x1) return x1 < rhs.x1;
-        // return x2 < rhs.x2;
+        __m128i x = _mm_load_si128(reinterpret_cast<__m128i const*>(this));
+        __m128i y = _mm_load_si128(reinterpret_cast<__m128i const*>(&rhs));
+        return cmplt_u128(x, y);
+        // if (x2 != rhs.x2) return x2 < rhs.x2;
+        // return x1 < rhs.x1;
+    }
+};
+
+/* The integer formed by the first bits/8 bytes of a string, in big-endian order.
+   Strings shorter than bits/8 are padded with zeros (and never read past their end),
+   so that the lexicographic order is preserved: if s < t, then from(s) <= from(t). */
+template <uint32_t bits>
+struct integer_prefix {
+    static_assert(bits == 32 or bits == 64 or bits == 128);
+    typedef std::conditional_t<bits == 32, uint32_t,
+                               std::conditional_t<bits == 64, uint64_t, uint128_t>>
+        type;
+    static const uint64_t bytes = bits / 8;
+
+    static type from(byte_range br) {
+        uint8_t const* ptr = br.begin;
+        uint8_t padded[bytes];
+        uint64_t size = br.end - br.begin;
+        if (size < bytes) {
+            memset(padded, 0, bytes);
+            memcpy(padded, br.begin, size);
+            ptr = padded;
+        }
+        if constexpr (bits == 32) {
+            uint32_t x;
+            memcpy(&x, ptr, 4);
+            return __builtin_bswap32(x);
+        } else if constexpr (bits == 64) {
+            uint64_t x;
+            memcpy(&x, ptr, 8);
+            return __builtin_bswap64(x);
+        } else {
+            uint64_t x[2];
+            memcpy(x, ptr, 16);
+            return {__builtin_bswap64(x[1]), __builtin_bswap64(x[0])};
+        }
+    }
+
+    static type from(std::string const& s) {
+        return from(byte_range_from_string(s));
+    }
+
+    // the first two bytes (i.e., radix_jump_table::key of the string)
+    static uint64_t first_two_bytes(type x) {
+        if constexpr (bits == 128) {
+            return x.x2 >> 48;
+        } else {
+            return x >> (bits - 16);
+        }
     }
 };
 
-uint128_t string_to_uint128(std::string const& s) {
-    uint64_t const* x = reinterpret_cast<uint64_t const*>(s.data());
-    return {__builtin_bswap64(x[1]), __builtin_bswap64(x[0])};  // for SIMD comparisons
-    // return {__builtin_bswap64(x[0]), __builtin_bswap64(x[1])}; // for scalar comparisons
+inline uint64_t string_to_uint64(std::string const& s) {
+    return integer_prefix<64>::from(s);
 }
 
-uint64_t byte_range_to_uint64(byte_range br) {
-    uint64_t size = br.end - br.begin;
-    uint64_t mask = size < 8 ? (1ULL << (size * 8)) - 1 : -1;
-    return __builtin_bswap64((*reinterpret_cast<uint64_t const*>(br.begin)) & mask);
-    // return __builtin_bswap64(*reinterpret_cast<uint64_t const*>(br.begin));
+inline uint64_t byte_range_to_uint64(byte_range br) {
+    return integer_prefix<64>::from(br);
 }
 
 inline bool byte_range_compare_v2(byte_range l, byte_range r) {
     uint64_t x1 = byte_range_to_uint64(l);
     uint64_t y1 = byte_range_to_uint64(r);
     if (x1 != y1) return x1 < y1;
-    uint64_t x2 = byte_range_to_uint64({l.begin + 8, l.end});
-    uint64_t y2 = byte_range_to_uint64({r.begin + 8, r.end});
-    if (x2 != y2) return x2 < y2;
+    if (l.end - l.begin >= 8 and r.end - r.begin >= 8) {
+        uint64_t x2 = byte_range_to_uint64({l.begin + 8, l.end});
+        uint64_t y2 = byte_range_to_uint64({r.begin + 8, r.end});
+        if (x2 != y2) return x2 < y2;
+    }
     return byte_range_compare(l, r) < 0;
 }
 
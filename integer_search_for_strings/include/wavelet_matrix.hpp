@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include <cassert>
+#include <cstdint>
+
+#include "bit_vector.hpp"
+
+/* A wavelet tree over a sequence of bytes, in its levelwise layout (the "wavelet matrix"
+   of Claude, Navarro and Ordóñez, Inf. Syst. 2015): level l stores the l-th most significant
+   bit of every symbol, in the order obtained by stably partitioning the symbols by their
+   previous bits (those with a 0 first). Each level is a bit_vector with rank1, so that
+   access and rank take 8 steps of one rank1 each. */
+
+struct wavelet_matrix {
+    static const uint64_t levels = 8;
+
+    wavelet_matrix() : m_size(0) {}
+
+    void build(std::vector<uint8_t> symbols) {
+        m_size = symbols.size();
+        std::vector<uint8_t> zeros, ones;
+        for (uint64_t l = 0; l != levels; ++l) {
+            uint64_t shift = levels - 1 - l;
+            bit_vector::builder builder;
+            zeros.clear();
+            ones.clear();
+            for (uint8_t c : symbols) {
+                bool bit = (c >> shift) & 1;
+                builder.push_back(bit);
+                (bit ? ones : zeros).push_back(c);
+            }
+            builder.build(m_levels[l]);
+            m_zeros[l] = zeros.size();
+            symbols.swap(zeros);
+            symbols.insert(symbols.end(), ones.begin(), ones.end());
+        }
+        // the position where the occurrences of c begin at the last level
+        for (uint64_t c = 0; c != 256; ++c) m_begins[c] = map(c, 0);
+    }
+
+    uint64_t size() const {
+        return m_size;
+    }
+
+    // number of occurrences of c in [0, i)
+    uint64_t rank(uint8_t c, uint64_t i) const {
+        assert(i <= size());
+        return map(c, i) - m_begins[c];
+    }
+
+    // the symbol at position i, and the number of its occurrences in [0, i) in rank
+    uint8_t access(uint64_t i, uint64_t* rank) const {
+        assert(i < size());
+        uint8_t c = 0;
+        for (uint64_t l = 0; l != levels; ++l) {
+            bit_vector const& bv = m_levels[l];
+            bool bit = bv[i];
+            c = (c << 1) | bit;
+            uint64_t r = bv.rank1(i);
+            i = bit ? m_zeros[l] + r : i - r;
+        }
+        *rank = i - m_begins[c];
+        return c;
+    }
+
+    uint64_t bytes() const {
+        uint64_t bytes = sizeof(m_zeros) + sizeof(m_begins);
+        for (auto const& bv : m_levels) bytes += bv.bytes();
+        return bytes;
+    }
+
+private:
+    uint64_t m_size;
+    bit_vector m_levels[levels];
+    uint64_t m_zeros[levels];
+    uint64_t m_begins[256];
+
+    // follow the path of c from position i of the first level
+    uint64_t map(uint8_t c, uint64_t i) const {
+        for (uint64_t l = 0; l != levels; ++l) {
+            uint64_t r = m_levels[l].rank1(i);
+            i = (c >> (levels - 1 - l)) & 1 ? m_zeros[l] + r : i - r;
+        }
+        return i;
+    }
+};
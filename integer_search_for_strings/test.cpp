@@ -1,17 +1,183 @@
 #include <iostream>
+#include <limits>
 
 #include "include/util.hpp"
 #include "include/string_pool.hpp"
 #include "include/fixed_string_pool.hpp"
 #include "include/prefix_indexed_string_pool.hpp"
-#include "include/prefix_indexed_string_pool_v2.hpp"
-#include "include/prefix_indexed_string_pool_v3.hpp"
 #include "include/front_coded_dictionary.hpp"
 #include "include/prefix_indexed_front_coded_dictionary.hpp"
+#include "include/adaptive_radix_tree.hpp"
+#include "include/external_front_coded_dictionary.hpp"
+#include "include/string_sorter.hpp"
+#include "include/louds_trie.hpp"
+#include "include/fm_index.hpp"
+#include "include/integer_prefix_lower_bound.hpp"
+#include "include/tracing.hpp"
 
 static const uint64_t prefix_size = 8;
 typedef std::chrono::microseconds duration_type;
 
+template <uint32_t PrefixBits, bool StripPrefix, uint64_t SamplingConstant>
+void test_prefix_indexed_string_pool(std::vector<std::string> const& strings,
+                                     std::vector<uint64_t> const& queries) {
+    std::cout << "==== prefix_indexed_string_pool<" << PrefixBits << ", " << StripPrefix << ", "
+              << SamplingConstant << ">\n";
+    typedef prefix_indexed_string_pool<PrefixBits, StripPrefix, SamplingConstant> pool_type;
+    typename pool_type::builder builder(strings.size());
+    pool_type pool;
+    builder.build(strings.begin(), strings.size());
+    builder.build(pool);
+    uint64_t sum = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto q : queries) sum += pool.lower_bound(strings[q]);
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+    std::cout << "elapsed " << elapsed.count() << std::endl;
+    std::cout << "##ignore " << sum << std::endl;
+    std::cout << "bytes: " << pool.bytes() << std::endl;
+}
+
+template <uint64_t BucketSize, bool IntegerKeys>
+void test_front_coded_dictionary(std::vector<std::string> const& strings,
+                                 std::vector<uint64_t> const& queries,
+                                 suffix_codec codec = suffix_codec::plain) {
+    std::cout << "==== front_coded_dictionary<" << BucketSize << ", " << IntegerKeys << "> ("
+              << codec_name(codec) << ")\n";
+    typedef front_coded_dictionary<BucketSize, IntegerKeys> fc_dict_type;
+    typename fc_dict_type::builder builder(codec);
+    fc_dict_type dict;
+    builder.build(strings.begin(), strings.size());
+    builder.build(dict);
+    uint64_t sum = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto q : queries) sum += dict.lookup(byte_range_from_string(strings[q]));
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+    std::cout << "lookup elapsed " << elapsed.count() << std::endl;
+    std::cout << "##ignore " << sum << std::endl;
+    sum = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (auto q : queries) sum += dict.lower_bound(byte_range_from_string(strings[q]));
+    stop = std::chrono::high_resolution_clock::now();
+    elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+    std::cout << "lower_bound elapsed " << elapsed.count() << std::endl;
+    std::cout << "##ignore " << sum << std::endl;
+    sum = 0;
+    std::vector<uint8_t> buffer(dict.max_string_length() + symbol_table::slack);
+    start = std::chrono::high_resolution_clock::now();
+    for (auto q : queries) sum += dict.access(q, buffer.data());
+    stop = std::chrono::high_resolution_clock::now();
+    elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+    std::cout << "access elapsed " << elapsed.count() << std::endl;
+    std::cout << "##ignore " << sum << std::endl;
+    sum = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (auto q : queries) sum += dict.access(q).size();
+    stop = std::chrono::high_resolution_clock::now();
+    elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+    std::cout << "access (std::string) elapsed " << elapsed.count() << std::endl;
+    std::cout << "##ignore " << sum << std::endl;
+    sum = 0;
+    static const uint64_t batch_size = 1000;
+    std::vector<uint8_t> arena;
+    std::vector<uint64_t> offsets;
+    start = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0; i < queries.size(); i += batch_size) {
+        dict.access(queries.data() + i, std::min(batch_size, queries.size() - i), arena, offsets);
+        sum += offsets.back();
+    }
+    stop = std::chrono::high_resolution_clock::now();
+    elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+    std::cout << "batch access (" << batch_size << " IDs per batch) elapsed " << elapsed.count()
+              << std::endl;
+    std::cout << "##ignore " << sum << std::endl;
+    {
+        // a small unsorted batch, with IDs sharing a bucket and repeated IDs
+        uint64_t n = dict.size();
+        std::vector<uint64_t> ids = {5 % n, 3 % n, (n - 1) / 2, 4 % n, 3 % n, n - 1, 0};
+        dict.access(ids.data(), ids.size(), arena, offsets);
+        for (uint64_t i = 0; i != ids.size(); ++i) {
+            std::string string(arena.begin() + offsets[i], arena.begin() + offsets[i + 1]);
+            if (string != dict.access(ids[i])) {
+                throw std::runtime_error("batch access failed for ID " +
+                                         std::to_string(ids[i]));
+            }
+        }
+    }
+    sum = 0;
+    std::vector<uint64_t> sorted_queries = queries;
+    for (uint64_t i = 0; i < queries.size(); i += batch_size) {
+        auto begin = sorted_queries.begin() + i;
+        std::sort(begin, begin + std::min(batch_size, queries.size() - i));
+    }
+    start = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0; i < queries.size(); i += batch_size) {
+        dict.access(sorted_queries.data() + i, std::min(batch_size, queries.size() - i), arena,
+                    offsets);
+        sum += offsets.back();
+    }
+    stop = std::chrono::high_resolution_clock::now();
+    elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+    std::cout << "batch access (" << batch_size << " sorted IDs per batch) elapsed "
+              << elapsed.count() << std::endl;
+    std::cout << "##ignore " << sum << std::endl;
+    std::cout << "bytes: " << dict.bytes() << " (bits per string "
+              << dict.bytes() * 8.0 / strings.size() << ")" << std::endl;
+}
+
+void test_louds_trie(std::vector<std::string> const& strings, std::vector<uint64_t> const& queries,
+                     suffix_codec codec = suffix_codec::plain) {
+    std::cout << "==== louds_trie (" << codec_name(codec) << ")\n";
+    louds_trie::builder builder(codec);
+    louds_trie trie;
+    builder.build(strings.begin(), strings.size());
+    builder.build(trie);
+    auto report = [&](char const* name, auto elapsed, uint64_t sum) {
+        std::cout << name << " elapsed " << elapsed.count() << " ("
+                  << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() /
+                         static_cast<double>(queries.size())
+                  << " ns/query)" << std::endl;
+        std::cout << "##ignore " << sum << std::endl;
+    };
+    uint64_t sum = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto q : queries) sum += trie.lookup(byte_range_from_string(strings[q]));
+    auto stop = std::chrono::high_resolution_clock::now();
+    report("lookup", std::chrono::duration_cast<duration_type>(stop - start), sum);
+    sum = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (auto q : queries) sum += trie.lower_bound(strings[q]);
+    stop = std::chrono::high_resolution_clock::now();
+    report("lower_bound", std::chrono::duration_cast<duration_type>(stop - start), sum);
+    sum = 0;
+    std::vector<uint8_t> buffer(trie.max_string_length() + symbol_table::slack);
+    start = std::chrono::high_resolution_clock::now();
+    for (auto q : queries) sum += trie.access(q, buffer.data());
+    stop = std::chrono::high_resolution_clock::now();
+    report("access", std::chrono::duration_cast<duration_type>(stop - start), sum);
+    std::cout << "bytes: " << trie.bytes() << " (bits per string "
+              << trie.bytes() * 8.0 / strings.size() << ")" << std::endl;
+}
+
+/* Print the number of distinct cache lines mapped to each set of the cache by the probes of
+   lower_bound, on one line (as cache_usage/plot_histograms.py expects). */
+template <typename Dictionary>
+void trace_cache_sets(char const* name, Dictionary& dict, std::vector<std::string> const& strings,
+                      std::vector<uint64_t> const& queries, cache_set_usage& cache) {
+    cache.clear();
+    dict.set_tracer(cache_set_tracer(&cache));
+    uint64_t sum = 0;
+    for (auto q : queries) sum += dict.lower_bound(byte_range_from_string(strings[q]));
+    dict.set_tracer(cache_set_tracer());
+    auto [total, max] = cache.lines();
+    std::cout << "=== " << name << ": distinct lines " << total << " (max per set " << max
+              << ", ways " << cache.ways() << ")" << std::endl;
+    std::cout << "cache usage:" << std::endl;
+    cache.print_usage(std::cout);
+    std::cout << "##ignore " << sum << std::endl;
+}
+
 int main(int argc, char const** argv) {
     if constexpr (prefix_size > 8) {
         std::cout << "prefix_size must be 8 at most" << std::endl;
@@ -25,17 +191,110 @@ int main(int argc, char const** argv) {
 
     // static const uint64_t min_string_len = 8 + 1;
     static const uint64_t min_string_len = 0;
-    static const uint64_t max_string_len = 256 + 1;
+    static const uint64_t max_string_len = std::numeric_limits<uint64_t>::max();
     std::vector<std::string> strings =
         read_string_collection(argv[1], min_string_len, max_string_len);
-    // note: strings should be already sorted
-    // std::sort(strings.begin(), strings.end());
+    if (!std::is_sorted(strings.begin(), strings.end()) or
+        std::adjacent_find(strings.begin(), strings.end()) != strings.end()) {
+        string_pool sorted = sorting::sort_and_deduplicate(strings);
+        strings.assign(sorted.begin(), sorted.end());
+        std::cout << "num. distinct strings " << strings.size() << std::endl;
+    }
     uint64_t n = strings.size();
     uint64_t num_queries = std::min<uint64_t>(3000000, n);
     splitmix64 random(13);
     std::vector<uint64_t> queries(num_queries);
     for (uint64_t i = 0; i != num_queries; ++i) queries[i] = random.next() % n;
 
+    std::cout << "simd kernels: " << simd::name(simd::current()) << std::endl;
+
+    {
+        // measure time for sorting (a shuffled copy of) the strings, in memory and on disk
+        std::cout << "====\n";
+        std::vector<std::string> shuffled = strings;
+        for (uint64_t i = n; i > 1; --i) std::swap(shuffled[i - 1], shuffled[random.next() % i]);
+        string_pool::builder builder(n);
+        string_pool pool;
+        builder.build(shuffled.begin(), n);
+        builder.build(pool);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::string> copy = shuffled;
+        std::sort(copy.begin(), copy.end());
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+        std::cout << "std::sort elapsed " << elapsed.count() << std::endl;
+
+        for (uint64_t threads = 1; threads <= sorting::default_threads(); threads *= 2) {
+            start = std::chrono::high_resolution_clock::now();
+            string_pool sorted = sorting::sort_and_deduplicate(pool, threads);
+            stop = std::chrono::high_resolution_clock::now();
+            elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+            std::cout << "sort_and_deduplicate (" << threads << " threads) elapsed "
+                      << elapsed.count() << std::endl;
+            if (sorted.size() != n or !std::equal(strings.begin(), strings.end(), sorted.begin())) {
+                std::cout << "sort_and_deduplicate failed (" << threads << " threads)" << std::endl;
+                return 1;
+            }
+        }
+
+        static const char* input_filename = "unsorted_strings.txt";
+        static const char* output_filename = "sorted_strings.txt";
+        std::ofstream out(input_filename);
+        for (auto const& s : shuffled) out << s << '\n';
+        out.close();
+        uint64_t bytes = 0;
+        for (auto const& s : strings) bytes += s.size();
+        start = std::chrono::high_resolution_clock::now();
+        uint64_t distinct = sorting::external_sort(input_filename, output_filename, bytes / 8);
+        stop = std::chrono::high_resolution_clock::now();
+        elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+        std::cout << "external_sort (memory budget 1/8 of the input) elapsed " << elapsed.count()
+                  << std::endl;
+        std::ifstream in(output_filename);
+        uint64_t matching = 0;  // lines of the output equal to the sorted strings
+        std::string line;
+        while (matching != n and std::getline(in, line) and line == strings[matching]) ++matching;
+        if (distinct != n or matching != n or in.peek() != EOF) {
+            std::cout << "external_sort failed: " << distinct << " distinct strings, " << matching
+                      << " of " << n << " in order" << std::endl;
+            return 1;
+        }
+        in.close();
+        std::cout << "##ignore " << distinct << std::endl;
+        std::remove(input_filename);
+        std::remove(output_filename);
+    }
+
+    {
+        // sort_and_deduplicate on long duplicates and long shared prefixes
+        std::cout << "====\n";
+        std::vector<std::string> input;
+        for (uint64_t i = 0; i != 100; ++i) input.push_back(std::string(3000, 'a'));
+        for (uint64_t i = 0; i != 40; ++i) input.push_back(std::string(20000, 'b'));
+        for (uint64_t i = 0; i != 100000; ++i) {  // large enough for the parallel distribution
+            input.push_back(std::string(200, 'c') + std::to_string(i % 1000));
+        }
+        for (uint64_t i = 0; i != 500; ++i) input.push_back(std::string(i, 'd'));
+        splitmix64 shuffle(13);
+        for (uint64_t i = input.size(); i > 1; --i) {
+            std::swap(input[i - 1], input[shuffle.next() % i]);
+        }
+        std::vector<std::string> expected = input;
+        std::sort(expected.begin(), expected.end());
+        expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+        for (uint64_t threads : {uint64_t(1), sorting::default_threads()}) {
+            string_pool sorted = sorting::sort_and_deduplicate(input, threads);
+            if (sorted.size() != expected.size() or
+                !std::equal(expected.begin(), expected.end(), sorted.begin())) {
+                std::cout << "sort_and_deduplicate failed on long duplicates" << std::endl;
+                return 1;
+            }
+        }
+        std::cout << "sort_and_deduplicate on long duplicates: " << input.size() << " strings, "
+                  << expected.size() << " distinct" << std::endl;
+    }
+
     // for (auto& s : strings) s.resize(prefix_size);
 
     {
@@ -53,6 +312,33 @@ int main(int argc, char const** argv) {
         std::cout << "##ignore " << sum << std::endl;
     }
 
+    {
+        // measure time for binary search on std::vector<std::string>, narrowing the range
+        // with the integer prefixes first (computed on the fly and from a side array)
+        std::cout << "====\n";
+        uint64_t sum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (auto q : queries) {
+            auto it = integer_prefix_lower_bound(strings.begin(), strings.end(), strings[q]);
+            sum += std::distance(strings.begin(), it);
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+        std::cout << "integer_prefix_lower_bound elapsed " << elapsed.count() << std::endl;
+        std::cout << "##ignore " << sum << std::endl;
+
+        integer_prefix_array prefixes;
+        prefixes.build(strings);
+        sum = 0;
+        start = std::chrono::high_resolution_clock::now();
+        for (auto q : queries) sum += prefixes.lower_bound(strings, strings[q]);
+        stop = std::chrono::high_resolution_clock::now();
+        elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+        std::cout << "integer_prefix_array elapsed " << elapsed.count() << std::endl;
+        std::cout << "##ignore " << sum << std::endl;
+        std::cout << "bytes: " << prefixes.bytes() << std::endl;
+    }
+
     {
         // measure time for binary search on contiguous strings
         std::cout << "====\n";
@@ -70,6 +356,47 @@ int main(int argc, char const** argv) {
         std::cout << "bytes: " << pool.bytes() << std::endl;
     }
 
+    {
+        // measure the speedup of the SIMD comparison kernels over the scalar ones
+        std::cout << "====\n";
+        string_pool::builder pool_builder(n);
+        string_pool pool;
+        pool_builder.build(strings.begin(), strings.size());
+        pool_builder.build(pool);
+        typedef front_coded_dictionary<16> fc_dict_type;
+        fc_dict_type::builder dict_builder;
+        fc_dict_type dict;
+        dict_builder.build(strings.begin(), strings.size());
+        dict_builder.build(dict);
+
+        double pool_scalar = 0, dict_scalar = 0;
+        for (auto level : simd::all_isas) {
+            if (!simd::supported(level)) {
+                std::cout << simd::name(level) << ": not supported" << std::endl;
+                continue;
+            }
+            simd::use(level);
+            uint64_t sum = 0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (auto q : queries) sum += pool.lower_bound(strings[q]);
+            auto stop = std::chrono::high_resolution_clock::now();
+            double pool_elapsed = std::chrono::duration_cast<duration_type>(stop - start).count();
+            start = std::chrono::high_resolution_clock::now();
+            for (auto q : queries) sum += dict.lookup(byte_range_from_string(strings[q]));
+            stop = std::chrono::high_resolution_clock::now();
+            double dict_elapsed = std::chrono::duration_cast<duration_type>(stop - start).count();
+            if (level == simd::isa::scalar) {
+                pool_scalar = pool_elapsed;
+                dict_scalar = dict_elapsed;
+            }
+            std::cout << simd::name(level) << ": string_pool elapsed " << pool_elapsed << " ("
+                      << pool_scalar / pool_elapsed << "X); front_coded_dictionary elapsed "
+                      << dict_elapsed << " (" << dict_scalar / dict_elapsed << "X)" << std::endl;
+            std::cout << "##ignore " << sum << std::endl;
+        }
+        simd::use(simd::detect());
+    }
+
     // {
     //     // measure time for binary search on contiguous fixed-size strings
     //     fixed_string_pool<prefix_size> pool(n);
@@ -86,8 +413,8 @@ int main(int argc, char const** argv) {
     {
         // measure time for binary search on prefix_indexed_string_pool
         std::cout << "====\n";
-        prefix_indexed_string_pool::builder builder(n);
-        prefix_indexed_string_pool pool;
+        prefix_indexed_string_pool<>::builder builder(n);
+        prefix_indexed_string_pool<> pool;
         builder.build(strings.begin(), strings.size());
         builder.build(pool);
         uint64_t sum = 0;
@@ -109,48 +436,227 @@ int main(int argc, char const** argv) {
         std::cout << "bytes: " << pool.bytes() << std::endl;
     }
 
-    // {
-    //     // measure time for binary search on prefix_indexed_string_pool_v2 (prefixes of 16 bytes,
-    //     // instead of 8)
-    //     prefix_indexed_string_pool_v2::builder builder(n);
-    //     prefix_indexed_string_pool_v2 pool;
-    //     builder.build(strings.begin(), strings.size());
-    //     builder.build(pool);
-    //     uint64_t sum = 0;
-    //     auto start = std::chrono::high_resolution_clock::now();
-    //     for (auto q : queries) sum += pool.lower_bound(strings[q]);
-    //     auto stop = std::chrono::high_resolution_clock::now();
-    //     auto elapsed = std::chrono::duration_cast<duration_type>(stop - start);
-    //     std::cout << "elapsed " << elapsed.count() << std::endl;
-    //     std::cout << "##ignore " << sum << std::endl;
-    // }
+    {
+        // measure the latency saved by a radix_jump_table (and the space it takes)
+        std::cout << "====\n";
+        string_pool::builder builder(n);
+        string_pool pool;
+        builder.build(strings.begin(), strings.size());
+        builder.build(pool);
+        fixed_string_pool<16> fixed_pool(n);
+        for (auto const& s : strings) fixed_pool.append(s);
+        prefix_indexed_string_pool<>::builder prefix_builder(n);
+        prefix_indexed_string_pool<> prefix_pool;
+        prefix_builder.build(strings.begin(), strings.size());
+        prefix_builder.build(prefix_pool);
 
-    // {
-    //     // measure time for binary search on prefix_indexed_string_pool_v3 that assumes all
-    //     strings
-    //     // to be longer than 8
-    //     prefix_indexed_string_pool_v3::builder builder(n);
-    //     prefix_indexed_string_pool_v3 pool;
-    //     builder.build(strings.begin(), strings.size());
-    //     builder.build(pool);
-    //     uint64_t sum = 0;
-    //     auto start = std::chrono::high_resolution_clock::now();
-    //     for (auto q : queries) sum += pool.lower_bound(strings[q]);
-    //     auto stop = std::chrono::high_resolution_clock::now();
-    //     auto elapsed = std::chrono::duration_cast<duration_type>(stop - start);
-    //     std::cout << "elapsed " << elapsed.count() << std::endl;
-    //     std::cout << "##ignore " << sum << std::endl;
-    //     std::cout << "bytes: " << pool.bytes() << std::endl;
-    // }
+        auto measure = [&](char const* name, auto const& pool) {
+            uint64_t sum = 0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (auto q : queries) sum += pool.lower_bound(strings[q]);
+            auto stop = std::chrono::high_resolution_clock::now();
+            auto elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+            std::cout << name << " elapsed " << elapsed.count() << "; bytes " << pool.bytes()
+                      << std::endl;
+            std::cout << "##ignore " << sum << std::endl;
+        };
+        measure("string_pool", pool);
+        measure("fixed_string_pool<16>", fixed_pool);
+        measure("prefix_indexed_string_pool<>", prefix_pool);
+        pool.build_jump_table();
+        fixed_pool.build_jump_table();
+        prefix_pool.build_jump_table();
+        measure("string_pool + jump table", pool);
+        measure("fixed_string_pool<16> + jump table", fixed_pool);
+        measure("prefix_indexed_string_pool<> + jump table", prefix_pool);
+    }
+
+    // other prefix widths, with and without prefix stripping
+    test_prefix_indexed_string_pool<32, false, 32>(strings, queries);
+    test_prefix_indexed_string_pool<128, false, 32>(strings, queries);
+    test_prefix_indexed_string_pool<64, true, 0>(strings, queries);
+    test_prefix_indexed_string_pool<128, true, 0>(strings, queries);
+
+    // front coding, without and with integer keys, for different bucket sizes
+    test_front_coded_dictionary<16, false>(strings, queries);
+    test_front_coded_dictionary<16, true>(strings, queries);
+    test_front_coded_dictionary<32, false>(strings, queries);
+    test_front_coded_dictionary<32, true>(strings, queries);
+    test_front_coded_dictionary<64, false>(strings, queries);
+    test_front_coded_dictionary<64, true>(strings, queries);
+
+    // front-coded suffixes compressed with a symbol table (compare bytes and time with plain)
+    test_front_coded_dictionary<16, false>(strings, queries, suffix_codec::fsst);
+    test_front_coded_dictionary<32, false>(strings, queries, suffix_codec::fsst);
+
+    // succinct trie, with plain and compressed tails (compare with front coding above)
+    test_louds_trie(strings, queries);
+    test_louds_trie(strings, queries, suffix_codec::fsst);
 
     {
-        // measure time for binary search on a front_coded_dictionary
+        // measure time for merging (overlapping) dictionaries, against decoding all the strings
+        // and building the merged dictionary from scratch
+        std::cout << "====\n";
+        typedef front_coded_dictionary<16> fc_dict_type;
+        static const uint64_t num_dicts = 4;
+        std::vector<std::vector<std::string>> parts(num_dicts);
+        for (auto const& s : strings) {
+            uint64_t r = random.next();
+            for (uint64_t k = 0; k != num_dicts; ++k) {
+                if ((r >> k) & 1) parts[k].push_back(s);  // each string is in half of the parts
+            }
+        }
+        std::vector<fc_dict_type> dicts(num_dicts);
+        std::vector<fc_dict_type const*> inputs;
+        for (uint64_t k = 0; k != num_dicts; ++k) {
+            fc_dict_type::builder builder;
+            builder.build(parts[k].begin(), parts[k].size());
+            builder.build(dicts[k]);
+            inputs.push_back(&dicts[k]);
+        }
+        std::vector<std::vector<std::string>>().swap(parts);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::string> decoded;
+        for (auto const& dict : dicts) {
+            for (uint64_t id = 0; id != dict.size(); ++id) decoded.push_back(dict.access(id));
+        }
+        std::sort(decoded.begin(), decoded.end());
+        decoded.erase(std::unique(decoded.begin(), decoded.end()), decoded.end());
+        fc_dict_type::builder builder;
+        fc_dict_type rebuilt;
+        builder.build(decoded.begin(), decoded.size());
+        builder.build(rebuilt);
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+        std::cout << "decode + sort + build elapsed " << elapsed.count() << std::endl;
+        std::vector<std::string>().swap(decoded);
+
+        start = std::chrono::high_resolution_clock::now();
+        fc_dict_type merged;
+        std::vector<std::vector<uint64_t>> remaps;
+        builder.merge(inputs, remaps);
+        builder.build(merged);
+        stop = std::chrono::high_resolution_clock::now();
+        elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+        std::cout << "merge of " << num_dicts << " dictionaries elapsed " << elapsed.count()
+                  << std::endl;
+        bool ok = merged.size() == rebuilt.size() and merged.bytes() == rebuilt.bytes();
+        for (uint64_t id = 0; ok and id != merged.size(); ++id) {
+            ok = merged.access(id) == rebuilt.access(id);
+        }
+        for (uint64_t k = 0; ok and k != num_dicts; ++k) {
+            ok = remaps[k].size() == dicts[k].size();
+            for (uint64_t j = 0; ok and j != dicts[k].size(); ++j) {
+                std::string s = dicts[k].access(j);
+                ok = remaps[k][j] == merged.lookup(byte_range_from_string(s));
+            }
+        }
+        if (!ok) {
+            std::cout << "merge differs from decode + sort + build" << std::endl;
+            return 1;
+        }
+        std::cout << "##ignore " << remaps.front().size() << std::endl;
+    }
+
+    {
+        // measure latency percentiles of lookups following a skewed distribution (90% of the
+        // queries on 0.1% of the strings), before and after building the hot layout from a log
         std::cout << "====\n";
         typedef front_coded_dictionary<16> fc_dict_type;
         fc_dict_type::builder builder;
         fc_dict_type dict;
         builder.build(strings.begin(), strings.size());
         builder.build(dict);
+        uint64_t num_hot = std::max<uint64_t>(1, n / 1000);
+        std::vector<uint64_t> hot_ids(num_hot);
+        for (auto& id : hot_ids) id = random.next() % n;
+        auto skewed = [&](uint64_t k) {
+            std::vector<std::string> log(k);
+            for (auto& s : log) {
+                uint64_t r = random.next();
+                s = strings[r % 10 ? hot_ids[(r >> 8) % num_hot] : (r >> 8) % n];
+            }
+            return log;
+        };
+        std::vector<std::string> log = skewed(100000);
+        std::vector<std::string> stream = skewed(num_queries);
+        std::vector<uint64_t> latencies(num_queries);
+        auto measure = [&](char const* label) {
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i != num_queries; ++i) {
+                auto start = std::chrono::high_resolution_clock::now();
+                sum += dict.lookup(byte_range_from_string(stream[i]));
+                auto stop = std::chrono::high_resolution_clock::now();
+                latencies[i] =
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+            }
+            std::sort(latencies.begin(), latencies.end());
+            auto percentile = [&](double p) { return latencies[p * (num_queries - 1)]; };
+            std::cout << label << ": latency (ns) p50 " << percentile(0.5) << ", p90 "
+                      << percentile(0.9) << ", p99 " << percentile(0.99) << "; bytes "
+                      << dict.bytes() << std::endl;
+            std::cout << "##ignore " << sum << std::endl;
+        };
+        measure("original layout");
+        dict.build_hot_layout(log.begin(), 0, 2 * num_hot);  // only clears the hot layout
+        dict.build_hot_layout(log.begin(), log.size(), 0);
+        if (dict.hot_bytes() != 0) {
+            std::cout << "build_hot_layout built a layout without queries or buckets" << std::endl;
+            return 1;
+        }
+        dict.build_hot_layout(log.begin(), log.size(), 2 * num_hot);
+        measure("hot layout");
+    }
+
+    {
+        // per-set usage of a 32 KiB 8-way L1 cache by the probes of 10,000 lower_bound queries
+        std::cout << "====\n";
+        std::vector<uint64_t> traced(queries.begin(),
+                                     queries.begin() + std::min<uint64_t>(10000, num_queries));
+        cache_set_usage L1(32 * 1024, 8);
+        {
+            basic_string_pool<cache_set_tracer>::builder builder(n);
+            basic_string_pool<cache_set_tracer> pool;
+            builder.build(strings.begin(), strings.size());
+            builder.build(pool);
+            trace_cache_sets("string_pool", pool, strings, traced, L1);
+        }
+        {
+            typedef prefix_indexed_string_pool<64, false, 32, cache_set_tracer> pool_type;
+            pool_type::builder builder(n);
+            pool_type pool;
+            builder.build(strings.begin(), strings.size());
+            builder.build(pool);
+            trace_cache_sets("prefix_indexed_string_pool<>", pool, strings, traced, L1);
+        }
+        {
+            typedef front_coded_dictionary<16, false, cache_set_tracer> fc_dict_type;
+            fc_dict_type::builder builder;
+            fc_dict_type dict;
+            builder.build(strings.begin(), strings.size());
+            builder.build(dict);
+            trace_cache_sets("front_coded_dictionary<16>", dict, strings, traced, L1);
+        }
+        {
+            typedef prefix_indexed_front_coded_dictionary<16, cache_set_tracer> fc_dict_type;
+            fc_dict_type::builder builder;
+            fc_dict_type dict;
+            builder.build(strings.begin(), strings.size());
+            builder.build(dict);
+            trace_cache_sets("prefix_indexed_front_coded_dictionary<16>", dict, strings, traced,
+                             L1);
+        }
+    }
+
+    {
+        // measure time for binary search on a prefix_indexed_front_coded_dictionary
+        std::cout << "====\n";
+        typedef prefix_indexed_front_coded_dictionary<16> fc_dict_type;
+        fc_dict_type::builder builder;
+        fc_dict_type dict;
+        builder.build(strings.begin(), strings.size());
+        builder.build(dict);
         uint64_t sum = 0;
         auto start = std::chrono::high_resolution_clock::now();
         for (auto q : queries) sum += dict.lookup(byte_range_from_string(strings[q]));
@@ -158,23 +664,148 @@ int main(int argc, char const** argv) {
         auto elapsed = std::chrono::duration_cast<duration_type>(stop - start);
         std::cout << "elapsed " << elapsed.count() << std::endl;
         std::cout << "##ignore " << sum << std::endl;
+        std::cout << "bytes: " << dict.bytes() << std::endl;
     }
 
     {
-        // measure time for binary search on a prefix_indexed_front_coded_dictionary
+        // measure I/Os per query and latency percentiles of an external_front_coded_dictionary,
+        // as the memory budget of its buffer pool grows
         std::cout << "====\n";
-        typedef prefix_indexed_front_coded_dictionary<16> fc_dict_type;
-        fc_dict_type::builder builder;
+        typedef external_front_coded_dictionary<16> fc_dict_type;
+        static const char* filename = "external_front_coded_dictionary.bin";
+        {
+            // a single string: no bucket has entries beyond its header, so the file has no pages
+            std::vector<std::string> one = {strings.front()};
+            fc_dict_type::builder builder(filename);
+            fc_dict_type dict;
+            builder.build(one.begin(), one.size());
+            builder.build(dict);
+            dict.open(0);
+            if (dict.file_bytes() != 0 or dict.lookup(byte_range_from_string(one[0])) != 0 or
+                dict.access(0) != one[0]) {
+                std::cout << "external_front_coded_dictionary failed on a single string"
+                          << std::endl;
+                return 1;
+            }
+        }
+        fc_dict_type::builder builder(filename);
         fc_dict_type dict;
         builder.build(strings.begin(), strings.size());
         builder.build(dict);
+        std::cout << "file bytes: " << dict.file_bytes() << std::endl;
+        std::vector<uint64_t> latencies(num_queries);
+        for (double fraction : {0.01, 0.05, 0.25, 1.0}) {
+            dict.open(fraction * dict.file_bytes());
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i != num_queries; ++i) {
+                auto start = std::chrono::high_resolution_clock::now();
+                sum += dict.lookup(byte_range_from_string(strings[queries[i]]));
+                auto stop = std::chrono::high_resolution_clock::now();
+                latencies[i] =
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+            }
+            std::sort(latencies.begin(), latencies.end());
+            auto percentile = [&](double p) { return latencies[p * (num_queries - 1)]; };
+            std::cout << "memory budget " << fraction * 100 << "% (" << dict.pool().num_frames()
+                      << " pages): I/Os per query "
+                      << static_cast<double>(dict.pool().reads()) / num_queries
+                      << "; latency (ns) p50 " << percentile(0.5) << ", p90 " << percentile(0.9)
+                      << ", p99 " << percentile(0.99) << ", p99.9 " << percentile(0.999)
+                      << "; in-memory bytes " << dict.bytes() << std::endl;
+            std::cout << "##ignore " << sum << std::endl;
+        }
+        std::remove(filename);
+    }
+
+    {
+        // measure count and locate of substrings on an fm_index, against a scan of the pool
+        std::cout << "====\n";
+        string_pool::builder pool_builder(n);
+        string_pool pool;
+        pool_builder.build(strings.begin(), strings.size());
+        pool_builder.build(pool);
+        auto start = std::chrono::high_resolution_clock::now();
+        fm_index::builder builder;
+        fm_index index;
+        builder.build(strings.begin(), strings.size());
+        builder.build(index);
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+        std::cout << "fm_index build elapsed " << elapsed.count() << "; bytes: " << index.bytes()
+                  << " (string_pool bytes: " << pool.bytes() << ")" << std::endl;
+
+        static const uint64_t num_patterns = 100;
+        std::vector<uint64_t> ids, expected;
+        for (uint64_t length : {3, 8, 16}) {
+            // random substrings of random strings
+            std::vector<std::string> patterns;
+            while (patterns.size() != num_patterns) {
+                std::string const& s = strings[random.next() % n];
+                if (s.size() < length) continue;
+                patterns.push_back(s.substr(random.next() % (s.size() - length + 1), length));
+            }
+            uint64_t sum = 0;
+            start = std::chrono::high_resolution_clock::now();
+            for (auto const& p : patterns) sum += index.count(byte_range_from_string(p));
+            stop = std::chrono::high_resolution_clock::now();
+            auto count_elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+            start = std::chrono::high_resolution_clock::now();
+            for (auto const& p : patterns) {
+                index.locate(byte_range_from_string(p), ids);
+                sum += ids.size();
+            }
+            stop = std::chrono::high_resolution_clock::now();
+            auto locate_elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+            start = std::chrono::high_resolution_clock::now();
+            for (auto const& p : patterns) {
+                pool.locate(byte_range_from_string(p), expected);
+                sum += expected.size();
+            }
+            stop = std::chrono::high_resolution_clock::now();
+            auto scan_elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+            for (auto const& p : patterns) {
+                index.locate(byte_range_from_string(p), ids);
+                pool.locate(byte_range_from_string(p), expected);
+                if (ids != expected) {
+                    std::cout << "fm_index::locate failed for pattern '" << p << "': "
+                              << ids.size() << " IDs instead of " << expected.size() << std::endl;
+                    return 1;
+                }
+            }
+            std::cout << "pattern length " << length << ": count elapsed "
+                      << count_elapsed.count() << "; locate elapsed " << locate_elapsed.count()
+                      << "; scan (" << simd::name(simd::current()) << ") elapsed "
+                      << scan_elapsed.count() << " (" << num_patterns << " patterns)"
+                      << std::endl;
+            std::cout << "##ignore " << sum << std::endl;
+        }
+    }
+
+    {
+        // measure time for lookup and lower_bound on an adaptive_radix_tree
+        std::cout << "====\n";
+        adaptive_radix_tree::builder builder;
+        adaptive_radix_tree tree;
+        builder.build(strings.begin(), strings.size());
+        builder.build(tree);
         uint64_t sum = 0;
         auto start = std::chrono::high_resolution_clock::now();
-        for (auto q : queries) sum += dict.lookup(byte_range_from_string(strings[q]));
+        for (auto q : queries) sum += tree.lookup(byte_range_from_string(strings[q]));
         auto stop = std::chrono::high_resolution_clock::now();
         auto elapsed = std::chrono::duration_cast<duration_type>(stop - start);
         std::cout << "elapsed " << elapsed.count() << std::endl;
         std::cout << "##ignore " << sum << std::endl;
+
+        std::cout << "====\n";
+        sum = 0;
+        start = std::chrono::high_resolution_clock::now();
+        for (auto q : queries) sum += tree.lower_bound(strings[q]);
+        stop = std::chrono::high_resolution_clock::now();
+        elapsed = std::chrono::duration_cast<duration_type>(stop - start);
+        std::cout << "elapsed " << elapsed.count() << std::endl;
+        std::cout << "##ignore " << sum << std::endl;
+        std::cout << "bytes: " << tree.bytes() << " (inner nodes: " << tree.tree_bytes() << ")"
+                  << std::endl;
     }
 
     return 0;